@@ -0,0 +1,56 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <glew.h>
+
+// pixel buffers the frames are read into, one is only mapped CAPTURE_PBO_COUNT - 1 frames after its read was issued
+#define CAPTURE_PBO_COUNT 3
+// frames waiting for the writer, a frame that does not fit is dropped instead of holding up the loop
+#define CAPTURE_QUEUE 8
+
+typedef struct {
+	uint8_t* pixels;
+	uint32_t width, height;
+	// number of the file, counted over the queued frames only
+	uint32_t index;
+} CaptureFrame;
+
+// records the drawn frames into a numbered PNG sequence without the frame loop ever waiting on the GPU or the disk
+typedef struct {
+	uint32_t pbo[CAPTURE_PBO_COUNT];
+	size_t pbo_capacity[CAPTURE_PBO_COUNT];
+	// signalled once the read into the buffer is done, NULL while the buffer holds nothing
+	GLsync fence[CAPTURE_PBO_COUNT];
+	uint32_t width[CAPTURE_PBO_COUNT], height[CAPTURE_PBO_COUNT];
+	// buffer the next frame is read into, the others follow it from the oldest read to the newest
+	uint32_t next;
+
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	CaptureFrame queue[CAPTURE_QUEUE];
+	uint32_t queue_head, queue_count;
+	uint8_t quit : 1;
+
+	char dir[256];
+	// frames drawn while recording, the ones that got dropped are not part of the sequence
+	uint32_t frame_count;
+	// frames handed to the writer, which also numbers the files without gaps
+	uint32_t queued;
+	uint32_t written;
+	// frames skipped since the GPU or the writer fell behind, the loop never waits on either
+	uint32_t dropped;
+	uint8_t active : 1;
+} Capture;
+
+// creates `dir` and starts recording into it
+int capture_start(Capture* capture, const char* dir);
+// reads the frame drawn into the back buffer, has to be called before the buffers are swapped
+void capture_frame(Capture* capture, uint32_t width, uint32_t height);
+// waits for the frames still on their way and for the writer to put them on disk
+void capture_stop(Capture* capture);
+
+#endif // __CAPTURE_H__
@@ -3,6 +3,11 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/types.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <evoco.h>
+#include <mesh_order.h>
 
 #define STRING_SLICE_CONTAIN 8
 typedef union {
@@ -36,8 +41,306 @@ typedef struct {
 	double left, right;
 	double bottom, top;
 	double near, far;
+	// value of the reserved `t` variable
+	double t;
 } CubeMarchDefintions;
 
-int cube_march(uint32_t** indicies, float** triangles, char* equation, VariableKV* vars, CubeMarchDefintions defs, char** err_msg);
+// token of one request, it is cancelled as soon as a newer generation gets published into `latest`
+typedef struct {
+	atomic_uint* latest;
+	uint32_t generation;
+} CancelToken;
+#define cancel_token_is_set(token) ((token) && atomic_load((token)->latest) != (token)->generation)
+
+typedef double (*Func)(double x, double y, double z, double t);
+// g of a formula written as `z - g(x, y)` or `g(x, y) - z`
+typedef double (*HeightFunc)(double x, double y, double t);
+// point of a parametric surface `(x(u, v), y(u, v), z(u, v))`, u and v both go over [0, 2pi]
+typedef void (*SurfaceFunc)(double u, double v, double t, double* out);
+#define SURFACE_SPAN (2.0 * M_PI)
+
+typedef enum {
+	VOLUME_FLOAT32,
+	VOLUME_UINT16,
+} VolumeFormat;
+// header in front of the raw samples of a volume file, the samples follow it with x changing the fastest
+#define VOLUME_MAGIC "RVOL"
+typedef struct {
+	char magic[4];
+	uint32_t nx, ny, nz;
+	uint32_t format;
+	// the surface is where the samples cross this value, the side above it counts as inside
+	float iso;
+} VolumeHeader;
+// sampled data mapped straight from its file, the samples are read in place and never copied into the heap
+typedef struct {
+	void* map;
+	size_t map_size;
+	const void* data;
+	uint32_t nx, ny, nz;
+	VolumeFormat format;
+	double iso;
+} Volume;
+int volume_open(Volume* volume, const char* path, char** err_msg);
+void volume_close(Volume* volume);
+
+// most level sets that one `f = c1, c2, ...` formula can ask for
+#define FORMULA_MAX_LEVELS 8
+// what the marchers sample on their lattice, a compiled formula or a mapped volume
+typedef struct {
+	Func func;
+	const Volume* volume;
+	// level sets to extract from the one sampled field, none means just f = 0
+	const double* levels;
+	uint32_t level_count;
+} Field;
+// index ranges of the level sets in one mesh, level i ends at ends[i] and starts where level i - 1 ended
+typedef struct {
+	uint32_t count;
+	uint32_t ends[FORMULA_MAX_LEVELS];
+} MeshLevels;
+// loaded shared object, reference counted since the mesh worker can still use it after the job is gone
+typedef struct {
+	void* handle;
+	Func func;
+	atomic_int refs;
+	uint8_t uses_time : 1;
+
+	HeightFunc height;
+	// 1 for `z - g`, -1 for `g - z`, decides which side the normals point to
+	int8_t height_sign;
+
+	SurfaceFunc surface;
+	// set instead of everything above for a formula loaded from a volume file
+	Volume* volume;
+
+	double levels[FORMULA_MAX_LEVELS];
+	uint8_t level_count;
+} Formula;
+Formula* formula_retain(Formula* formula);
+void formula_release(Formula* formula);
+Formula* formula_from_volume(const char* path, char** err_msg);
+
+typedef enum {
+	FORMULA_NOTHING,
+	FORMULA_COMPILING,
+	FORMULA_ERROR,
+	FORMULA_READY,
+} FormulaState;
+// a compile of one equation into a shared object, gcc runs as a child process so it can be polled or thrown away
+typedef struct {
+	FormulaState state;
+	pid_t pid;
+	uint32_t id;
+
+	char* equation;
+	char src_path[64];
+	char lib_path[64];
+
+	Formula* formula;
+	uint8_t uses_time : 1;
+	uint8_t is_surface : 1;
+	int8_t height_sign;
+	double levels[FORMULA_MAX_LEVELS];
+	uint8_t level_count;
+} FormulaJob;
+
+int formula_job_start(FormulaJob* job, char* equation, VariableKV* vars, char** err_msg);
+FormulaState formula_job_poll(FormulaJob* job, int block, char** err_msg);
+void formula_job_discard(FormulaJob* job);
+
+// one z-range of the grid, marched by a single thread; every buffer is kept between runs
+typedef struct {
+	uint32_t k_begin, k_end;
+	size_t capacity;
+	// field sampled on the bottom and the top plane of the current layer of cubes
+	double* values[2];
+	// vertex ids on the x edges, y edges and points of both planes, and on the z edges between them
+	uint32_t* edges[2];
+	uint32_t* z_edges;
+	// edges of the bottom plane, used to stitch the slab onto the one below it
+	uint32_t* first_edges;
+	uint32_t* remap;
+	size_t remap_capacity;
+
+	uint32_t* indices;
+	float* vertices;
+	// first vertex id handed out, above 0 when the finished vertices get flushed out layer by layer
+	uint32_t vertex_base;
+	// keys of the bricks in which the coarse pre-pass saw the surface
+	uint32_t* active;
+	int done;
+} MarchSlab;
+
+// grids from SPARSE_MIN_RES up are only sampled in bricks of BRICK_SIZE^3 cells around the surface
+#define SPARSE_MIN_RES 128
+#define BRICK_SIZE 8
+#define BRICK_SIDE (BRICK_SIZE + 1)
+#define BRICK_POINTS (BRICK_SIDE * BRICK_SIDE * BRICK_SIDE)
+typedef struct {
+	uint32_t bx, by, bz;
+	double values[BRICK_POINTS];
+} Brick;
+// slot of an open addressed table, empty slots hold GRID_KEY_NONE
+#define GRID_KEY_NONE UINT64_MAX
+typedef struct {
+	uint64_t key;
+	uint32_t value;
+} GridKV;
+
+#define MARCHER_MAX_THREADS 16
+typedef struct Marcher Marcher;
+typedef int (*MarcherTask)(Marcher* marcher, MarchSlab* slab);
+typedef struct {
+	pthread_t thread;
+	Marcher* marcher;
+	uint32_t slab;
+} MarcherThread;
+struct Marcher {
+	MarcherThread threads[MARCHER_MAX_THREADS - 1];
+	uint32_t thread_count;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t finished;
+	uint32_t round;
+	uint32_t running;
+	uint8_t quit : 1;
+
+	MarcherTask task;
+	Field field;
+	HeightFunc height;
+	SurfaceFunc surface;
+	CubeMarchDefintions defs;
+	CancelToken* cancel;
+	uint32_t slab_count;
+	MarchSlab slabs[MARCHER_MAX_THREADS];
+
+	// samples and vertex ids of the heightfield grid
+	double* heights;
+	uint32_t* height_ids;
+	size_t height_capacity;
+	// positions and normals of the parametric surface grid
+	float* samples;
+	size_t samples_capacity;
+
+	// the bricks and both tables live in the arena, which is recycled on every sparse run
+	EvoArena brick_arena;
+	Brick** bricks;
+	GridKV* brick_table;
+	size_t brick_capacity;
+	// vertices on the faces of the bricks, shared with the neighbouring bricks
+	GridKV* edge_table;
+	size_t edge_capacity;
+	size_t edge_count;
+	uint32_t* brick_edges;
+};
+
+void marcher_start(Marcher* marcher);
+int marcher_run(Marcher* marcher, uint32_t** indicies, float** triangles, Field field, CubeMarchDefintions defs, CancelToken* cancel);
+// O(res^2) grid mesh for formulas that are explicit in z
+int heightfield_run(Marcher* marcher, uint32_t** indicies, float** triangles, HeightFunc g, int8_t sign, CubeMarchDefintions defs, CancelToken* cancel);
+// marching cubes over the resident bricks only, memory grows with the surface instead of the volume
+// every level of `field` is marched from the same bricks, `levels` (can be NULL) gets the index range of each one
+int sparse_run(Marcher* marcher, uint32_t** indicies, float** triangles, MeshLevels* levels, Field field, CubeMarchDefintions defs, CancelToken* cancel);
+// res x res grid over (u, v), the bounds of `defs` are not used
+int surface_run(Marcher* marcher, uint32_t** indicies, float** triangles, SurfaceFunc s, CubeMarchDefintions defs, CancelToken* cancel);
+void marcher_stop(Marcher* marcher);
+
+// `levels` (can be NULL) gets the index range of each level set of the formula
+int cube_march_formula(uint32_t** indicies, float** triangles, MeshLevels* levels, Formula* formula, CubeMarchDefintions defs, CancelToken* cancel);
+int cube_march(uint32_t** indicies, float** triangles, char* equation, VariableKV* vars, CubeMarchDefintions defs, char** err_msg, CancelToken* cancel);
+
+// background thread building meshes, only the latest submitted request is ever published
+typedef struct {
+	Formula* formula;
+	CubeMarchDefintions defs;
+	uint32_t generation;
+} MeshRequest;
+// what is known about the mesh being taken, copied out under the lock since the next build writes it
+typedef struct {
+	// how long building it took
+	double seconds;
+	// average cache misses per triangle before and after the reordering, both 0 if it got skipped
+	double acmr[2];
+} MeshStats;
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	atomic_uint latest;
+	Marcher marcher;
+
+	MeshRequest pending;
+	uint8_t has_pending : 1;
+	uint8_t has_ready : 1;
+	uint8_t quit : 1;
+	// also renumber the vertices in the order the reordered triangles use them, off by default since
+	// nothing has measured the fetch order paying for the extra pass; set it before the first submit
+	uint8_t order_vertices : 1;
+
+	// worker side buffers, swapped with the ready ones when a mesh gets published
+	uint32_t* indices;
+	float* vertices;
+	MeshLevels levels;
+	Meshlet* meshlets;
+	uint32_t* ready_indices;
+	float* ready_vertices;
+	MeshLevels ready_levels;
+	Meshlet* ready_meshlets;
+	uint32_t ready_generation;
+	// how long building the ready mesh took
+	double ready_seconds;
+
+	// scratch of the vertex cache reordering, recycled for every mesh
+	EvoArena order_arena;
+	// average cache misses per triangle before and after the reordering, both 0 if it got skipped
+	double acmr[2];
+	double ready_acmr[2];
+	// called from the worker thread once a mesh is ready to be taken, can be NULL
+	void (*notify)(void);
+} MeshWorker;
+
+void mesh_worker_start(MeshWorker* worker, void (*notify)(void));
+uint32_t mesh_worker_submit(MeshWorker* worker, Formula* formula, CubeMarchDefintions defs);
+void mesh_worker_cancel(MeshWorker* worker);
+// swaps the ready buffers with the given ones (all cyx arrays), the meshlets split up the index buffer for culling
+int mesh_worker_take(MeshWorker* worker, uint32_t** indices, float** vertices, MeshLevels* levels, Meshlet** meshlets, MeshStats* stats);
+void mesh_worker_stop(MeshWorker* worker);
+
+// marches `f` layer by layer straight into a binary PLY file at `path`, only O(res^2) is ever held in memory
+// the file is built up in `path`.tmp, `path` only ever holds a finished mesh
+int stream_march(const char* path, Func f, CubeMarchDefintions defs, CancelToken* cancel, atomic_uint* progress, char** err_msg);
+
+typedef enum {
+	EXPORT_NOTHING,
+	EXPORT_RUNNING,
+	EXPORT_DONE,
+	EXPORT_FAILED,
+} ExportState;
+// an offline export on its own thread, polled from the frame loop like a FormulaJob
+typedef struct {
+	ExportState state;
+	pthread_t thread;
+	atomic_uint latest;
+	uint32_t generation;
+	// layers of cubes written out so far
+	atomic_uint layers;
+	atomic_int finished;
+	int result;
+
+	Formula* formula;
+	CubeMarchDefintions defs;
+	char path[256];
+	char* err_msg;
+	// called from the export thread once it is done, can be NULL
+	void (*notify)(void);
+} MeshExport;
+
+int mesh_export_start(MeshExport* job, Formula* formula, CubeMarchDefintions defs, const char* path, char** err_msg);
+ExportState mesh_export_poll(MeshExport* job);
+double mesh_export_progress(MeshExport* job);
+void mesh_export_cancel(MeshExport* job);
+// cancels the export and waits for its thread, the unfinished file gets removed
+void mesh_export_stop(MeshExport* job);
 
 #endif // __CUBE_MARCHING__
@@ -12,26 +12,8 @@
 #define BEZIER_STEP 0.2
 #endif // BEZIER_STEP
 
-typedef struct {
-	uint32_t vao, vbo, ebo, program;
-	size_t indices_count;
-	Color clr;
-	Vec2i pos;
-	float projection_mat[16];
-} Polygon;
-
-struct __PolygonCreateParams {
-	GlyphData* __glyph;
-	uint32_t __program;
-	float __scale;
-	int x;
-	int y;
-	size_t width;
-	size_t height;
-};
-Polygon __turn_glyph_into_polygon(struct __PolygonCreateParams params);
-#define turn_glyph_into_polygon(glyph, program, scale, ...) __turn_glyph_into_polygon(((struct __PolygonCreateParams){ .__glyph = (glyph), .__program = program, .__scale = scale, __VA_ARGS__ }))
-void poly_show(Polygon* poly, int x, int y, float w, float h, int screen_w, int screen_h);
-void poly_free(Polygon* poly);
+// triangulates the outline of the glyph in pixels (y pointing down), the vertices get appended as x, y pairs
+// and the indices already point past the vertices that were in the array before
+void turn_glyph_into_triangles(GlyphData* glyph, float scale, float** vertices, uint32_t** indices);
 
 #endif // __EAR_CLIPPING_H__
@@ -3,13 +3,47 @@
 
 #include <ttf.h>
 #include <ear_clipping.h>
+#include <program.h>
+#include <gl_state.h>
+#include <sdf.h>
+
+#ifndef FONT_SDF_SIZE
+// pixels per em of the distance field atlas, every font size gets scaled from it
+#define FONT_SDF_SIZE 48
+#endif // FONT_SDF_SIZE
+#ifndef FONT_SDF_SPREAD
+#define FONT_SDF_SPREAD 6
+#endif // FONT_SDF_SPREAD
+#define FONT_SDF_ATLAS_WIDTH 512
+
+typedef enum {
+	// every glyph ear clipped into triangles at the size of the font
+	FONT_MESH,
+	// quads textured from a signed distance field atlas, drawn with PROGRAM_FONT_SDF
+	FONT_SDF,
+} FontBackend;
 
 typedef struct {
-	Polygon poly;
+	// triangles of the glyph in the packed index array of the font
+	uint32_t first_index;
+	uint32_t index_count;
+	// quad of the glyph in pixels from the pen (left, top, right, bottom) and where it is in the atlas
+	float quad[4];
+	float uv[4];
 	uint8_t found;
 	int32_t advance;
 } Letter;
 
+// distance field of every glyph of one font file, built once and shared by every size the file is compiled at
+typedef struct {
+	char path[256];
+	uint32_t texture;
+	uint32_t refs;
+	// quad of the glyph in atlas pixels from the pen (left, top, right, bottom) and where it is in the atlas
+	float quad[128][4];
+	float uv[128][4];
+} FontAtlas;
+
 typedef struct {
 	TTF ttf;
 	int size;
@@ -17,12 +51,43 @@ typedef struct {
 
 	Vec2i screen_wh;
 
-	uint32_t program;
+	const Program* program;
+	FontBackend backend;
 	Letter letters[128];
+
+	// every glyph triangulated once, x and y pairs in pixels relative to the pen
+	float* glyph_vertices;
+	uint32_t* glyph_indices;
+	// only for FONT_SDF, the quads of the letters are the ones of the atlas scaled to the size of the font
+	FontAtlas* atlas;
+
+	// triangles queued since the last flush, already moved to where they are drawn,
+	// x and y pairs for FONT_MESH and x, y, u, v for FONT_SDF
+	float* batch;
+	uint32_t vao, vbo;
+	size_t vbo_capacity;
 } FontTTF;
 
-FontTTF font_compile(uint32_t program, const char* font_file_path, int size, int screen_width, int screen_height);
-int font_show(FontTTF* font, char c, int x, int y, int screen_w, int screen_h);
+// text laid out once into its own buffer, drawn again without going through the glyphs
+typedef struct {
+	uint32_t vao, vbo;
+	uint32_t vertex_count;
+	// where it was laid out, a different place or screen size means it has to be laid out again
+	int x, y, w, h;
+	Vec2i screen_wh;
+	uint8_t dirty : 1;
+} TextMesh;
+
+FontTTF font_compile(const Program* program, FontBackend backend, const char* font_file_path, int size, int screen_width, int screen_height);
+// queues the letter with the pen at (x, y) and returns how far the pen moves
+int font_queue(FontTTF* font, char c, int x, int y);
+// draws everything queued so far in `color` with a single draw call
+void font_flush(FontTTF* font, Color color, int screen_w, int screen_h);
+// moves everything queued so far into the mesh instead of drawing it
+void font_bake(FontTTF* font, TextMesh* mesh);
+// the colour is not baked into the mesh, so it can change without laying the text out again
+void font_show_mesh(FontTTF* font, TextMesh* mesh, Color color, int screen_w, int screen_h);
+void text_mesh_free(TextMesh* mesh);
 int font_get_advance(FontTTF* font, char c);
 int font_get_text_width(FontTTF* font, size_t n, const char* str);
 void font_free(FontTTF* font);
@@ -0,0 +1,44 @@
+#ifndef __GL_STATE_H__
+#define __GL_STATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <glew.h>
+
+// the capabilities the show functions switch, anything else is set once and left alone
+typedef enum {
+	GL_STATE_DEPTH_TEST,
+	GL_STATE_CULL_FACE,
+	GL_STATE_BLEND,
+	GL_STATE_CAP_COUNT,
+} GlStateCap;
+
+// forgets everything it knows, the next call of each kind always reaches the driver
+void gl_state_reset(void);
+
+// these only call into GL when the value differs from the one set last
+void gl_use_program(uint32_t program);
+void gl_bind_vertex_array(uint32_t vao);
+void gl_set_cap(GlStateCap cap, int enabled);
+void gl_viewport(int x, int y, int w, int h);
+void gl_blend_func(GLenum src, GLenum dst);
+
+// GL 1.1 comes straight from libGL instead of through GLEW, so the calls a frame makes go through these to be counted
+void gl_clear_color(float r, float g, float b, float a);
+void gl_clear(GLbitfield mask);
+void gl_flush(void);
+void gl_bind_texture(GLenum target, uint32_t texture);
+void gl_draw_elements(GLenum mode, int count, GLenum type, const void* indices);
+void gl_draw_arrays(GLenum mode, int first, int count);
+
+// deleting what is bound unbinds it, so the tracker has to hear about it
+void gl_delete_program(uint32_t program);
+void gl_delete_vertex_arrays(int count, const uint32_t* vaos);
+
+// calls that went through to the driver and the ones skipped since the start
+size_t gl_state_issued(void);
+size_t gl_state_elided(void);
+// libGL calls made through this file since the start, tracked or not
+size_t gl_state_core_calls(void);
+
+#endif // __GL_STATE_H__
@@ -12,50 +12,59 @@
 #include <shapes.h>
 #include <font.h>
 #include <mat.h>
+#include <capture.h>
 
 #define WIDTH 1600
 #define HEIGHT 900
 typedef struct Context Context;
 
 // timer
+// frames per second the cap holds, each frame gets its own deadline 1/TIMER_FPS_CAP after the one before
+#define TIMER_FPS_CAP 75
+// the sleep wakes up this long before the deadline and spins the rest, sleeps overshoot by about that much
+#define TIMER_SPIN_NS 300000
+// frame times the percentiles are taken over
+#define TIMER_HISTORY 256
 typedef struct {
+	float p50, p95, p99, max;
+	size_t count;
+} FrameStats;
+typedef struct {
+	double start_time;
+	// seconds since the first frame, the value of `t` in the formulas
+	double elapsed;
 	double prev_time;
 	double collection;
 	double dt;
 
 	size_t frames;
+	struct timespec deadline;
+	// milliseconds each of the last frames took, a ring of TIMER_HISTORY
+	float frame_ms[TIMER_HISTORY];
+	size_t frame_next;
+	size_t frame_count;
+	// calls counted up to the last log, see gl_count_calls and gl_state.h
+	size_t gl_calls;
+	size_t gl_state_issued;
+	size_t gl_state_elided;
 	char log;
 	char fps_cap;
 } Timer;
 void updateTimer(Timer* timer);
+// percentiles of the last TIMER_HISTORY frame times in milliseconds
+FrameStats timer_frame_stats(const Timer* timer);
 
 // programs
-#define check_shader_compile_status(shader, shader_name) do { \
-	int success; \
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &success); \
-	if (!success) { \
-		char info_log[512]; \
-		glGetShaderInfoLog(shader, 512, NULL, info_log);\
-		fprintf(stderr, "ERROR:\tUnable to compile shader [\"%s\"]!\nLOG:\t%s\n", shader_name, info_log); \
-	} \
-} while(0)
-#define check_program_compile_status(program) do { \
-	int success; \
-	glGetProgramiv(program, GL_COMPILE_STATUS, &success); \
-	if (!success) { \
-		char info_log[512]; \
-		glGetProgramInfoLog(program, 512, NULL, info_log);\
-		fprintf(stderr, "ERROR:\tUnable to compile program!\nLOG:\t%s\n", info_log); \
-	} \
-} while(0)
-uint32_t compile_program(EvoAllocator* alloc, const char* vert_file, const char* frag_file);
-
 enum ProgramNames {
 	PROGRAM_FONT,
-	PROGRAM_RECT,
 	PROGRAM_3D,
+	PROGRAM_IMAGE,
+	PROGRAM_FONT_SDF,
+	PROGRAM_RECT_BATCH,
 	PROGRAM_COUNT,
 };
+// linked programs are kept here between runs, the sources only get compiled when they or the driver changed
+#define PROGRAM_CACHE_DIR "./build"
 
 // events
 typedef struct {
@@ -78,6 +87,7 @@ typedef enum {
 	SHOWABLE_STATIC_TEXT,
 	SHOWABLE_RECT,
 	SHOWABLE_3D,
+	SHOWABLE_IMAGE,
 
 	DATA_SEPARATOR,
 
@@ -107,11 +117,14 @@ struct SceneShowable {
 		struct {
 			char* text;
 			Color clr;
+			// the laid out text, only laid out again when it changes or moves
+			TextMesh mesh;
 			uint8_t center_x : 1;
 			uint8_t center_y : 1;
 		} static_text;
 		Rectangle rect;
 		Shape3D shape;
+		Image image;
 	} as;
 	void (*click)(Context* ctx, SceneShowable* showable);
 };
@@ -256,6 +269,14 @@ void __grid_add(struct __GridAddParams params);
 	.world_pos = (wrld_pos), \
 	 __VA_ARGS__ \
 }))
+// the pixels are handed over with image_update on the showable from grid_get
+#define grid_image(ctx, pos, id, ...) (__grid_add((struct __GridAddParams){ \
+	.__ctx = (ctx), \
+	.__pos = (pos), \
+	.__id = (id), \
+	.__type = SHOWABLE_IMAGE, \
+	__VA_ARGS__ \
+}))
 #define grid_end(ctx) cyx_array_pop((ctx)->grids)
 
 ScenePair grid_get(Context* ctx, const char* id, SceneDataType type);
@@ -331,11 +352,14 @@ typedef struct {
 	void (*setup)(Context* ctx);
 	void (*show)(Context*);
 	void (*key_callback)(Context*, char key, int value);
+	// called from context_cleanup if the scene got set up, while the window and the arenas still exist
+	void (*cleanup)(Context* ctx);
 } SceneDescription;
 typedef struct {
 	void (*setup)(Context* ctx);
 	void (*show)(Context*);
 	void (*key_callback)(Context*, char key, int value);
+	void (*cleanup)(Context* ctx);
 	uint8_t setup_done : 1;
 } Scene;
 typedef struct {
@@ -345,6 +369,10 @@ typedef struct {
 
 // context
 #define FONT_MAX_COUNT 10
+// frames drawn after anything changes, an event only shows up the frame after it and that frame can change values again
+#define CONTEXT_REDRAW_FRAMES 3
+// longest the loop sleeps on the window events when the scene did not ask to be woken up sooner
+#define CONTEXT_IDLE_WAIT_MS 1000
 struct Context {
 // timer
 	Timer timer;
@@ -355,10 +383,18 @@ struct Context {
 	uint8_t fullscreen : 1;
 
 // opengl programs
-	uint32_t programs[PROGRAM_COUNT];
+	Program programs[PROGRAM_COUNT];
+	// set before context_setup to compile every program from its sources
+	uint8_t program_cache_off : 1;
+	// rectangles waiting to be drawn, flushed before anything else gets drawn over them
+	RectBatch rect_batch;
+	// view and light of the 3D shapes, shared by all of them
+	CameraBlock camera_block;
 
 // font data
 	char* font_dir;
+	// set before context_setup to draw the text from a distance field atlas
+	FontBackend font_backend;
 	NameSizePair curr_font;
 	FontKV* fonts;
 
@@ -396,6 +432,16 @@ struct Context {
 		uint8_t alt_held : 1;
 	} key_info;
 
+// redraw, the loop sleeps until an event comes in while there is nothing to draw
+	uint32_t redraw_frames;
+	// the scene wants a frame within this many milliseconds even without events, -1 if it does not
+	int wake_ms;
+	// of the scene values after the last frame, a frame that changes them is followed by more
+	uint64_t values_hash;
+
+// frames read back into a PNG sequence while it is active, every frame gets drawn meanwhile
+	Capture capture;
+
 // mouse flag awaiting processing
 	SceneShowable* showable_clicked;
 	struct {
@@ -413,6 +459,14 @@ struct Context {
 
 void context_setup(Context* ctx, size_t scene_count, SceneDescription* scenes);
 void context_update(Context* ctx);
+// the next CONTEXT_REDRAW_FRAMES frames get drawn
+void context_redraw(Context* ctx);
+// a frame gets drawn within `ms` milliseconds, for work that is polled from the frame loop
+void context_wake_in(Context* ctx, int ms);
+// cuts the wait on the window events short, the one call that is safe from other threads
+void context_wake(void);
+// starts recording the frames into `dir` or stops the recording going on
+void context_toggle_capture(Context* ctx, const char* dir);
 void context_cleanup(Context* ctx);
 
 #define push_event(ctx, event) cyx_ring_push((ctx)->event_queue, CUSTOM_EVENT(event))
@@ -44,6 +44,11 @@ Vec4* mat4_mult_vec4_self(Mat4 mat, Vec4* self);
 
 Mat4 mat4_transpose(Mat4 mat);
 Mat4* mat4_transpose_self(Mat4* self);
+// a singular matrix gives back all zeros
+Mat4 mat4_inverse(Mat4 mat);
+Mat4* mat4_inverse_self(Mat4* self);
+// transpose of the inverse, takes normals into the space the model matrix takes positions to
+Mat4 mat4_normal(Mat4 model);
 
 Mat4 mat4_ortho(float left, float right, float top, float bottom, float near, float far);
 Mat4* mat4_ortho_self(Mat4* self, float left, float right, float top, float bottom, float near, float far);
@@ -0,0 +1,39 @@
+#ifndef __MESH_ORDER_H__
+#define __MESH_ORDER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <evoco.h>
+
+// post-transform cache the orders are tuned for, a FIFO of this many vertices
+#define MESH_ORDER_CACHE_SIZE 16
+// floats per vertex of the marched meshes, the position followed by the normal
+#define MESH_VERTEX_FLOATS 6
+
+// average cache misses per triangle of a FIFO of `cache_size` vertices over the index buffer, 0.5 is the best a grid can do
+double mesh_acmr(EvoArena* arena, const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size);
+// Tipsify (Sander, Nehab, Barczak 2007): triangles get reordered in place so their vertices stay in the cache,
+// the clusters this breaks the mesh into are then put outward facing first to cut down on overdraw
+void mesh_order_triangles(EvoArena* arena, uint32_t* indices, size_t index_count, const float* vertices, uint32_t vertex_count, uint32_t cache_size);
+// renumbers the vertices in the order the indices first use them, so the vertex fetches go through memory in order
+void mesh_order_vertices(EvoArena* arena, uint32_t* indices, size_t index_count, float* vertices, uint32_t vertex_count);
+
+// triangles per meshlet, the last one of every range can have fewer
+#define MESHLET_TRIANGLES 128
+// a run of consecutive triangles that gets culled as a whole before drawing
+typedef struct {
+	// bounding sphere in the space of the mesh
+	float center[3];
+	float radius;
+	// normals of the triangles (by their winding) all lie within the cone around `cone_axis`,
+	// `cone_cutoff` is the sine of its half angle or 1 when the cone is too wide to ever cull
+	float cone_axis[3];
+	float cone_cutoff;
+	uint32_t first_index;
+	uint32_t index_count;
+} Meshlet;
+
+// splits the triangles into meshlets (a cyx array) that never cross the end of an index range
+void mesh_build_meshlets(Meshlet** meshlets, const uint32_t* indices, const float* vertices, uint32_t range_count, const uint32_t* range_ends);
+
+#endif // __MESH_ORDER_H__
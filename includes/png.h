@@ -0,0 +1,9 @@
+#ifndef __PNG_H__
+#define __PNG_H__
+
+#include <stdint.h>
+
+// writes width * height RGBA pixels into an uncompressed PNG, `bottom_up` for rows in the order GL reads them
+int png_write(const char* path, uint32_t width, uint32_t height, const uint8_t* pixels, int bottom_up);
+
+#endif // __PNG_H__
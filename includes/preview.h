@@ -0,0 +1,85 @@
+#ifndef __PREVIEW_H__
+#define __PREVIEW_H__
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <color.h>
+#include <mat.h>
+#include <cube_marching.h>
+
+// side of the square tiles the image is split into, every thread takes the next free tile
+#define PREVIEW_TILE 16
+// steps along one ray before it counts as a miss
+#define PREVIEW_MAX_STEPS 512
+// the step never gets longer than this fraction of the box diagonal, so thin parts are not jumped over
+#define PREVIEW_MAX_STEP_FRACTION (1.0 / 96.0)
+#define PREVIEW_MIN_STEP_FRACTION (1.0 / 4096.0)
+// the mesh worker marches on every core while the preview is traced, so the preview only gets this share of them
+#define PREVIEW_CPU_SHARE 2
+#define PREVIEW_MAX_THREADS 16
+
+// everything shape3d_show would use to draw the mesh, the preview is lit the same way
+typedef struct {
+	Vec4 camera;
+	Vec4 light_pos;
+	Color light_color;
+	// one colour per level set, the first one for a formula without levels
+	Color colors[FORMULA_MAX_LEVELS];
+	float scale;
+	float shininess;
+	float reflectivity;
+	uint32_t width, height;
+} PreviewView;
+
+typedef enum {
+	PREVIEW_NOTHING,
+	PREVIEW_RUNNING,
+	PREVIEW_DONE,
+} PreviewState;
+// sphere traced image of a formula straight from its compiled function, polled from the frame loop like a MeshExport
+typedef struct {
+	PreviewState state;
+	pthread_t thread;
+	atomic_uint latest;
+	uint32_t generation;
+	atomic_int finished;
+	int result;
+
+	Formula* formula;
+	CubeMarchDefintions defs;
+	PreviewView view;
+	// bound on |grad f| over the box, steps of |f| / lipschitz can not cross the surface
+	double lipschitz;
+	atomic_uint next_tile;
+
+	// helpers taking tiles next to the job thread, started with the first preview and kept until preview_free
+	pthread_t helpers[PREVIEW_MAX_THREADS - 1];
+	uint32_t helper_count;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t tiles_done;
+	uint32_t round;
+	uint32_t running;
+	uint8_t pool_started : 1;
+	uint8_t quit : 1;
+
+	// width * height RGBA pixels, the first row is the top of the image
+	uint8_t* pixels;
+	size_t capacity;
+	double seconds;
+	// called from the tracing thread once the image is done, can be NULL
+	void (*notify)(void);
+} PreviewJob;
+
+// fails for formulas without an implicit function, a still running preview gets cancelled first
+int preview_start(PreviewJob* job, Formula* formula, CubeMarchDefintions defs, PreviewView view);
+PreviewState preview_poll(PreviewJob* job);
+// returns 1 once for every finished image, its pixels stay valid until the next preview_start
+int preview_take(PreviewJob* job);
+void preview_cancel(PreviewJob* job);
+// also stops the helper threads
+void preview_free(PreviewJob* job);
+
+#endif // __PREVIEW_H__
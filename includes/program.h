@@ -0,0 +1,68 @@
+#ifndef __PROGRAM_H__
+#define __PROGRAM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <glew.h>
+
+#define CYLIBX_ALLOC
+#include <cylibx.h>
+
+#define check_shader_compile_status(shader, shader_name) do { \
+	int success; \
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success); \
+	if (!success) { \
+		char info_log[512]; \
+		glGetShaderInfoLog(shader, 512, NULL, info_log);\
+		fprintf(stderr, "ERROR:\tUnable to compile shader [\"%s\"]!\nLOG:\t%s\n", shader_name, info_log); \
+	} \
+} while(0)
+#define check_program_compile_status(program) do { \
+	int success; \
+	glGetProgramiv(program, GL_LINK_STATUS, &success); \
+	if (!success) { \
+		char info_log[512]; \
+		glGetProgramInfoLog(program, 512, NULL, info_log);\
+		fprintf(stderr, "ERROR:\tUnable to compile program!\nLOG:\t%s\n", info_log); \
+	} \
+} while(0)
+
+// every uniform any of the shaders declares, a program has -1 for the ones it does not use
+typedef enum {
+	UNIFORM_PROJ,
+	UNIFORM_MODEL,
+	UNIFORM_NORMAL,
+	UNIFORM_COLOR,
+	UNIFORM_SHININESS,
+	UNIFORM_REFLECTIVITY,
+	UNIFORM_TEXTURE,
+	UNIFORM_COUNT,
+} UniformName;
+
+// uniform blocks the shaders declare, each one is bound to the binding point of its own value
+typedef enum {
+	UNIFORM_BLOCK_CAMERA,
+	UNIFORM_BLOCK_COUNT,
+} UniformBlockName;
+
+// a linked program with the locations of its active uniforms looked up once after linking
+typedef struct {
+	uint32_t id;
+	int32_t uniforms[UNIFORM_COUNT];
+	// loaded from a binary the driver stored earlier instead of compiled from the sources
+	uint8_t from_cache : 1;
+} Program;
+
+// the linked binaries go into `cache_dir` (NULL for no cache) under a hash of the sources and of the driver,
+// so an edited shader or another driver never picks up a stale one
+Program compile_program(EvoAllocator* alloc, const char* vert_file, const char* frag_file, const char* cache_dir);
+void program_free(Program* program);
+
+// counts the calls that go through the GLEW entry points (program, uniform, buffer and vertex array calls)
+// plus the GL 1.1 ones made through gl_state.h (draws, clears, textures, caps and viewport),
+// meant for comparing how many of them a frame makes
+void gl_count_calls(void);
+size_t gl_call_count(void);
+
+#endif // __PROGRAM_H__
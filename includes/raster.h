@@ -0,0 +1,96 @@
+#ifndef __RASTER_H__
+#define __RASTER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <color.h>
+#include <mat.h>
+#include <shapes.h>
+#include <png.h>
+
+// side of the square tiles the target is split into, a triangle is binned into every tile its bounds touch
+#define RASTER_TILE 32
+// pixels of one row the edge functions and the depth test are evaluated for at once
+#define RASTER_LANES 8
+#define RASTER_MAX_THREADS 16
+// floats of a transformed vertex, its clip position, world position and normal
+#define RASTER_VERTEX_FLOATS 10
+
+typedef float RasterLanes __attribute__((vector_size(RASTER_LANES * sizeof(float))));
+typedef int32_t RasterMask __attribute__((vector_size(RASTER_LANES * sizeof(int32_t))));
+
+// a triangle set up for the tiles, in pixels of the target
+typedef struct {
+	// edge functions a x + b y + c of the edges opposite each corner, positive inside and scaled by 1 / area
+	float a[3], b[3], c[3];
+	// all ones for the top and left edges, a pixel centre right on one of them belongs to this triangle
+	int32_t top_left[3];
+	float depth[3];
+	// world positions and normals of the corners divided by their clip w, for perspective correct interpolation
+	float world[3][3], normal[3][3], inv_w[3];
+	int32_t min_x, min_y, max_x, max_y;
+	Color color;
+} RasterTriangle;
+
+// triangles one thread set up and the tiles it binned them into, kept between draws
+typedef struct {
+	RasterTriangle* triangles;
+	// one cyx array per tile of indices into `triangles`, in the order they were submitted
+	uint32_t** bins;
+} RasterBins;
+
+typedef struct Raster Raster;
+typedef void (*RasterTask)(Raster* raster, uint32_t thread);
+typedef struct {
+	pthread_t thread;
+	Raster* raster;
+	uint32_t index;
+} RasterThread;
+// draws what shape3d_show and the rect batch draw on the CPU, for rendering without a GPU or a display
+struct Raster {
+	uint32_t width, height;
+	// width * height RGBA pixels, the first row is the top of the image
+	uint8_t* pixels;
+	float* depth;
+	uint32_t tiles_x, tiles_y;
+
+	RasterThread threads[RASTER_MAX_THREADS - 1];
+	uint32_t thread_count;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t finished;
+	uint32_t round;
+	uint32_t running;
+	uint8_t quit : 1;
+	RasterTask task;
+	atomic_uint next_tile;
+
+	// the draw being run
+	const Shape3D* shape;
+	const uint32_t* indices;
+	size_t index_count;
+	const float* vertices;
+	uint32_t vertex_count;
+	int view_x, view_y, view_w, view_h;
+	Mat4 model, normal, clip;
+	float* transformed;
+	size_t transformed_capacity;
+	RasterBins bins[RASTER_MAX_THREADS];
+};
+
+// 0 when the buffers could not be allocated, there is nothing to stop then
+int raster_start(Raster* raster, uint32_t width, uint32_t height);
+// fills the pixels with `color` and the depth buffer with the far plane
+void raster_clear(Raster* raster, Color color);
+// the mesh the way shape3d_show draws it, the shape only lends its view, light, material and ranges;
+// the viewport is measured from the top left corner of the target
+void raster_shape3d(Raster* raster, const Shape3D* shape, const uint32_t* indices, size_t index_count, const float* vertices, uint32_t vertex_count, int x, int y, int w, int h);
+void raster_rect(Raster* raster, const Rectangle* rect, int x, int y, int w, int h);
+// uncompressed RGBA PNG of the pixels
+int raster_write_png(const Raster* raster, const char* path);
+void raster_stop(Raster* raster);
+
+#endif // __RASTER_H__
@@ -0,0 +1,22 @@
+#ifndef __SDF_H__
+#define __SDF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ttf.h>
+
+// a texel at `spread` pixels or more from the outline is fully inside (255) or outside (0), the outline itself is 128
+typedef struct {
+	// pixels per font unit
+	float scale;
+	int spread;
+} SdfParams;
+
+// size of the cell the glyph needs, its box plus the spread on every side
+void sdf_glyph_size(const GlyphData* glyph, SdfParams params, int* w, int* h);
+// fills the w x h cell starting at `pixels` (rows `stride` bytes apart, the first row is the top of the glyph)
+// with the signed distance to the outline of the glyph
+void sdf_render_glyph(const GlyphData* glyph, SdfParams params, uint8_t* pixels, size_t stride, int w, int h);
+
+#endif // __SDF_H__
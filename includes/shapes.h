@@ -5,46 +5,85 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <glew.h>
+#include <program.h>
+#include <gl_state.h>
 #include <vec2.h>
 #include <color.h>
+#include <mesh_order.h>
 
+// what a rectangle looks like, it is drawn by pushing it into a RectBatch
 typedef struct {
 	Color color;
 	Color border_color;
 	int border_width;
-
-	uint32_t vao, vbo, ebo;
-	uint32_t program;
 } Rectangle;
 
-struct __RectangleCreateParams {
-	uint32_t __program;
-	Color __color;
-
-	Color border_color;
-	int border_width;
-};
-
 #define TO_OPENGL_COORDS_X(x, width) (((float)(x) / (width)) * 2.0f - 1.0f) 
 #define TO_OPENGL_COORDS_Y(y, height) (-((float)(y) / (height)) * 2.0f + 1.0f) 
 
-Rectangle __rect_create(struct __RectangleCreateParams);
-#define rect_create(program, color, ...) (__rect_create(((struct __RectangleCreateParams){\
-	.__program = (program), \
-	.__color = (color), \
-	__VA_ARGS__ \
-})))
-void rect_show(Rectangle* rect, int x, int y, int w, int h, int screen_w, int screen_h);
-void rect_free(Rectangle* rect);
+// floats of one rectangle in the instance buffer: x, y, w, h, colour, border colour and the border in quad units
+#define RECT_INSTANCE_FLOATS 14
+// rectangles collected over a frame and drawn as instances of a single quad
+typedef struct {
+	uint32_t vao, quad_vbo, instance_vbo;
+	size_t instance_capacity;
+	const Program* program;
+	float* instances;
+} RectBatch;
+
+RectBatch rect_batch_create(const Program* program);
+void rect_batch_push(RectBatch* batch, const Rectangle* rect, int x, int y, int w, int h);
+// draws everything pushed so far with one instanced draw, has to happen before anything that could be drawn over them
+void rect_batch_flush(RectBatch* batch, int screen_w, int screen_h);
+void rect_batch_free(RectBatch* batch);
+
+// projection of shape3d_show, anything drawn to line up with the meshes has to use the same one
+#define SHAPE3D_FOV 60
+#define SHAPE3D_NEAR 1
+#define SHAPE3D_FAR 200
+#define SHAPE3D_MAX_RANGES 8
+// the Camera block of shader3d in its std140 layout, the vec3s take up a whole vec4
+typedef struct {
+	float proj[16];
+	float view[16];
+	float light_color[4];
+	float light_pos[4];
+	float view_pos[4];
+} CameraBlockData;
+// uniform buffer with what all the shapes in one view share, only uploaded again when that changes
+typedef struct {
+	uint32_t ubo;
+	CameraBlockData data;
+	uint8_t filled : 1;
+} CameraBlock;
+
+CameraBlock camera_block_create(void);
+void camera_block_set(CameraBlock* block, const CameraBlockData* data);
+void camera_block_free(CameraBlock* block);
 
 typedef struct {
 	Color color;
 	Vec4 pos;
 
-	uint32_t vao, vbo, ebo;
-	uint32_t program;
+	// two sets of buffers, a new mesh is uploaded into the one that is not being drawn
+	uint32_t vao[2], vbo[2], ebo[2];
+	// bytes allocated for each buffer, the first mesh fits exactly and a bigger one at least doubles them
+	size_t vbo_capacity[2], ebo_capacity[2];
+	uint32_t indicies_count[2];
+	uint8_t front : 1;
+	// index ranges of the shown mesh drawn in colours of their own, the first one in `color`
+	uint32_t range_ends[SHAPE3D_MAX_RANGES];
+	uint32_t range_count;
+	// meshlets of the shown mesh (a cyx array), the ones out of view or facing away are not drawn,
+	// without them the whole index buffer is drawn
+	Meshlet* meshlets;
+	// index counts and byte offsets of the meshlets that made it through, for glMultiDrawElements
+	GLsizei* draw_counts;
+	void** draw_offsets;
+	uint32_t visible_meshlets;
+	const Program* program;
+	CameraBlock* camera_block;
 
-	uint32_t indicies_count;
 	Vec4 camera;
 	float scale;
 
@@ -57,8 +96,32 @@ typedef struct {
 	uint8_t depth_test : 1;
 } Shape3D;
 
-Shape3D shape3d_create(uint32_t program, Color color, float scale, uint32_t* indices, float* triangle_coords);
-void shape3d_show(Shape3D* shape, int x, int y, int w, int h, int screen_w, int screen_h);
+Shape3D shape3d_create(const Program* program, CameraBlock* camera_block, Color color, float scale, uint32_t* indices, float* triangle_coords);
+void shape3d_update(Shape3D* shape, uint32_t* indices, float* triangle_coords);
+// splits the shown mesh into ranges, an update goes back to a single range
+void shape3d_set_ranges(Shape3D* shape, uint32_t range_count, const uint32_t* range_ends);
+// copies the meshlets of the shown mesh, an update drops them again
+void shape3d_set_meshlets(Shape3D* shape, const Meshlet* meshlets, size_t count);
+// colour range `range` is drawn in, range 0 takes the colour of the shape
+Color shape3d_range_color(Color color, uint32_t range);
+void shape3d_show(Shape3D* shape, int x, int y, int w, int h);
 void shape3d_free(Shape3D* shape);
 
+// RGBA pixels from the CPU stretched over a viewport the same way shape3d_show sets it up
+typedef struct {
+	uint32_t vao, vbo, ebo;
+	uint32_t texture;
+	const Program* program;
+	int width, height;
+	// size of the viewport it was last shown in
+	int shown_w, shown_h;
+} Image;
+
+Image image_create(const Program* program);
+void image_update(Image* image, int width, int height, const uint8_t* rgba);
+// an image without pixels does not draw anything
+void image_clear(Image* image);
+void image_show(Image* image, int x, int y, int w, int h);
+void image_free(Image* image);
+
 #endif // __SHAPES_H__
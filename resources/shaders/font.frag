@@ -1,8 +1,8 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform vec4 color;
+uniform vec4 u_color;
 
 void main() {
-	FragColor = color;
+	FragColor = u_color;
 }
@@ -0,0 +1,15 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 v_uv;
+
+uniform sampler2D u_texture;
+uniform vec4 u_color;
+
+void main() {
+	// the outline is at 0.5, the edge is smoothed over about a pixel whatever the scale
+	float distance = texture(u_texture, v_uv).r;
+	float width = 0.7 * fwidth(distance);
+	float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+	FragColor = vec4(u_color.rgb, u_color.a * alpha);
+}
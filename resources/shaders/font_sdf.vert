@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec2 pos;
+layout (location = 1) in vec2 uv;
+
+out vec2 v_uv;
+
+uniform mat4 u_proj;
+
+void main() {
+	v_uv = uv;
+	gl_Position = u_proj * vec4(pos, 0, 1);
+}
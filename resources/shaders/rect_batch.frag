@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 v_pos;
+flat in vec4 v_color;
+flat in vec4 v_border_color;
+flat in vec2 v_border;
+
+void main() {
+	FragColor = (!(v_border.x > 0) || !(v_border.y > 0) ||
+			(v_pos.x > -1.0f + v_border.x &&
+			 v_pos.x <  1.0f - v_border.x &&
+			 v_pos.y > -1.0f + v_border.y &&
+			 v_pos.y <  1.0f - v_border.y)) ?
+		v_color : v_border_color;
+}
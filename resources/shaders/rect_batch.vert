@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec2 a_pos;
+layout (location = 1) in vec4 a_rect;
+layout (location = 2) in vec4 a_color;
+layout (location = 3) in vec4 a_border_color;
+layout (location = 4) in vec2 a_border;
+
+uniform mat4 u_proj;
+
+out vec2 v_pos;
+flat out vec4 v_color;
+flat out vec4 v_border_color;
+flat out vec2 v_border;
+
+void main() {
+	v_pos = a_pos;
+	v_color = a_color;
+	v_border_color = a_border_color;
+	v_border = a_border;
+	gl_Position = u_proj * vec4(a_rect.xy + a_rect.zw * 0.5 * (a_pos + 1), 0, 1);
+}
@@ -4,10 +4,15 @@ out vec4 FragColor;
 in vec3 normal;
 in vec3 frag_pos;
 
+layout (std140) uniform Camera {
+	mat4 u_proj;
+	mat4 u_view;
+	vec4 u_light_color;
+	vec3 u_light_pos;
+	vec3 u_view_pos;
+};
+
 uniform vec4 u_color;
-uniform vec4 u_light_color;
-uniform vec3 u_light_pos;
-uniform vec3 u_view_pos;
 uniform float u_shininess;
 uniform float u_reflectivity;
 
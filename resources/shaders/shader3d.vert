@@ -2,15 +2,22 @@
 layout (location = 0) in vec3 a_pos;
 layout (location = 1) in vec3 a_norm;
 
+layout (std140) uniform Camera {
+	mat4 u_proj;
+	mat4 u_view;
+	vec4 u_light_color;
+	vec3 u_light_pos;
+	vec3 u_view_pos;
+};
+
 uniform mat4 u_model;
-uniform mat4 u_view;
-uniform mat4 u_proj;
+uniform mat4 u_normal;
 
 out vec3 normal;
 out vec3 frag_pos;
 
 void main() {
 	gl_Position = u_proj * u_view * u_model * vec4(a_pos, 1.0);
-	normal = mat3(transpose(inverse(u_model))) * a_norm;
+	normal = mat3(u_normal) * a_norm;
 	frag_pos = vec3(u_model * vec4(a_pos, 1.0));
 }
@@ -0,0 +1,157 @@
+#include <capture.h>
+#include <png.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+static void* capture_writer(void* arg) {
+	Capture* capture = arg;
+
+	pthread_mutex_lock(&capture->lock);
+	for (;;) {
+		while (!capture->queue_count && !capture->quit) {
+			pthread_cond_wait(&capture->cond, &capture->lock);
+		}
+		// whatever is queued still gets written after the quit
+		if (!capture->queue_count) { break; }
+		CaptureFrame frame = capture->queue[capture->queue_head];
+		pthread_mutex_unlock(&capture->lock);
+
+		char path[sizeof(capture->dir) + 32];
+		snprintf(path, sizeof(path), "%s/frame_%05u.png", capture->dir, frame.index);
+		int ok = png_write(path, frame.width, frame.height, frame.pixels, 1);
+		free(frame.pixels);
+
+		pthread_mutex_lock(&capture->lock);
+		capture->queue_head = (capture->queue_head + 1) % CAPTURE_QUEUE;
+		--capture->queue_count;
+		capture->written += ok;
+	}
+	pthread_mutex_unlock(&capture->lock);
+	return NULL;
+}
+
+int capture_start(Capture* capture, const char* dir) {
+	if (mkdir(dir, 0755) && errno != EEXIST) {
+		fprintf(stderr, "ERROR:\tUnable to create the capture directory [\"%s\"]!\n", dir);
+		return 0;
+	}
+
+	*capture = (Capture){ 0 };
+	snprintf(capture->dir, sizeof(capture->dir), "%s", dir);
+	glGenBuffers(CAPTURE_PBO_COUNT, capture->pbo);
+	pthread_mutex_init(&capture->lock, NULL);
+	pthread_cond_init(&capture->cond, NULL);
+	pthread_create(&capture->writer, NULL, capture_writer, capture);
+	capture->active = 1;
+
+	printf("LOG:\tCapturing frames into [\"%s\"]\n", dir);
+	return 1;
+}
+
+// copies out the finished read of buffer `slot` and queues it for the writer
+static void capture_collect(Capture* capture, uint32_t slot) {
+	glDeleteSync(capture->fence[slot]);
+	capture->fence[slot] = NULL;
+
+	pthread_mutex_lock(&capture->lock);
+	int has_room = capture->queue_count < CAPTURE_QUEUE;
+	pthread_mutex_unlock(&capture->lock);
+	if (!has_room) {
+		++capture->dropped;
+		return;
+	}
+
+	size_t size = (size_t)capture->width[slot] * capture->height[slot] * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbo[slot]);
+	const uint8_t* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (!mapped) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		++capture->dropped;
+		return;
+	}
+	// numbered only once it is sure to be written, a dropped frame must not leave a gap in the sequence
+	CaptureFrame frame = {
+		.pixels = malloc(size),
+		.width = capture->width[slot],
+		.height = capture->height[slot],
+	};
+	if (!frame.pixels) {
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		++capture->dropped;
+		return;
+	}
+	frame.index = capture->queued++;
+	memcpy(frame.pixels, mapped, size);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// only the writer takes frames off the queue, so the room checked above is still there
+	pthread_mutex_lock(&capture->lock);
+	capture->queue[(capture->queue_head + capture->queue_count) % CAPTURE_QUEUE] = frame;
+	++capture->queue_count;
+	pthread_cond_signal(&capture->cond);
+	pthread_mutex_unlock(&capture->lock);
+}
+void capture_frame(Capture* capture, uint32_t width, uint32_t height) {
+	if (!capture->active || !width || !height) { return; }
+
+	++capture->frame_count;
+	// going from the oldest read, the ones that are done get handed over, the read of the last frame is never waited for
+	for (uint32_t i = 0; i + 1 < CAPTURE_PBO_COUNT; ++i) {
+		uint32_t slot = (capture->next + i) % CAPTURE_PBO_COUNT;
+		if (!capture->fence[slot]) { continue; }
+		if (glClientWaitSync(capture->fence[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+			// the next frame would be read into this buffer, it is skipped instead of waiting on the GPU
+			if (slot == capture->next) {
+				++capture->dropped;
+				return;
+			}
+			break;
+		}
+		capture_collect(capture, slot);
+	}
+
+	uint32_t slot = capture->next;
+	size_t size = (size_t)width * height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbo[slot]);
+	if (size > capture->pbo_capacity[slot]) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		capture->pbo_capacity[slot] = size;
+	}
+	// with a pack buffer bound this only queues the copy, the pixels land in the buffer later
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	capture->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	capture->width[slot] = width;
+	capture->height[slot] = height;
+	capture->next = (slot + 1) % CAPTURE_PBO_COUNT;
+}
+void capture_stop(Capture* capture) {
+	if (!capture->active) { return; }
+
+	for (uint32_t i = 0; i < CAPTURE_PBO_COUNT; ++i) {
+		uint32_t slot = (capture->next + i) % CAPTURE_PBO_COUNT;
+		if (!capture->fence[slot]) { continue; }
+		glClientWaitSync(capture->fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+		capture_collect(capture, slot);
+	}
+
+	pthread_mutex_lock(&capture->lock);
+	capture->quit = 1;
+	pthread_cond_signal(&capture->cond);
+	pthread_mutex_unlock(&capture->lock);
+	pthread_join(capture->writer, NULL);
+	pthread_mutex_destroy(&capture->lock);
+	pthread_cond_destroy(&capture->cond);
+	glDeleteBuffers(CAPTURE_PBO_COUNT, capture->pbo);
+	capture->active = 0;
+
+	printf("LOG:\tCaptured %u frames into [\"%s\"], %u written, %u dropped\n",
+		capture->frame_count, capture->dir, capture->written, capture->dropped);
+}
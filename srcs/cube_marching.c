@@ -8,8 +8,13 @@
 
 #include <unistd.h>
 #include <sys/wait.h>
+#include <signal.h>
 #include <dlfcn.h>
 #include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define CYLIBX_ALLOC
 #include <cylibx.h>
@@ -399,6 +404,8 @@ typedef enum {
 	OP_AND = 'a',
 	OP_OR = 'o',
 	OP_NOT = 'n',
+	OP_COMMA = ',',
+	OP_EQUALS = '=',
 } OperatorType;
 typedef union {
 	TokenType type;
@@ -479,6 +486,7 @@ static double lexer_lex_double(Lexer* lex, int* err, char** err_msg) {
 	}
 
 	char* endptr;
+	errno = 0;
 	double ret = strtold(lex->str + lex->curr, &endptr);
 
 	while (lex->str + lex->curr != endptr) { lex->curr++; }
@@ -578,6 +586,12 @@ static int lexer_lex(Lexer* lex, char* str, size_t len, char** err_msg) {
 		} else if (lex->str[lex->curr] == '>') {
 			t.type = TOKEN_OPERATOR;
 			t.operator.op_type = OP_GREATER;
+		} else if (lex->str[lex->curr] == ',') {
+			t.type = TOKEN_OPERATOR;
+			t.operator.op_type = OP_COMMA;
+		} else if (lex->str[lex->curr] == '=') {
+			t.type = TOKEN_OPERATOR;
+			t.operator.op_type = OP_EQUALS;
 		} else if ('0' <= lex->str[lex->curr] && lex->str[lex->curr] <= '9') {
 			int err = 0;
 			double num = lexer_lex_double(lex, &err, err_msg);
@@ -621,12 +635,17 @@ static int lexer_lex(Lexer* lex, char* str, size_t len, char** err_msg) {
 		} else if (lex->str[lex->curr] == '\0') {
 			t.type = TOKEN_EOF;
 		} else {
-			assert(0 && "UNREACHABLE");
+			if (err_msg) {
+				cyx_str_append_lit(err_msg, "ERROR:\tUnknown character [");
+				cyx_str_append_char(err_msg, lex->str[lex->curr]);
+				cyx_str_append_lit(err_msg, "] in the expression!\n");
+			}
+			return 0;
 		}
 
 		cyx_array_append(lex->tokens, t);
 	}
-	if (cyx_array_top(lex->tokens)->type != TOKEN_EOF) {
+	if (!cyx_array_length(lex->tokens) || cyx_array_top(lex->tokens)->type != TOKEN_EOF) {
 		cyx_array_append(lex->tokens, ((Token){ .type = TOKEN_EOF }));
 	}
 
@@ -779,6 +798,11 @@ static Node* parse_expr_bp(Lexer* lex, uint8_t min_bp, char** err_msg) {
 				if (!lhs) { return NULL; }
 
 				lhs = node_not(&lex->pool, lhs);
+			} else {
+				if (err_msg) {
+					cyx_str_append_lit(err_msg, "ERROR:\tUnexpected operator!\n");
+				}
+				return NULL;
 			}
 		} break;
 		case TOKEN_FUNC_ID: {
@@ -838,8 +862,15 @@ static Node* parse_expr_bp(Lexer* lex, uint8_t min_bp, char** err_msg) {
 			default: 
 				if (err_msg) {
 					cyx_str_append_lit(err_msg, "ERROR:\tExpected an operator after an operand!\n");
-					return NULL;
 				}
+				return NULL;
+		}
+		// half typed text can leave an operator without its left side
+		if (!lhs) {
+			if (err_msg && !cyx_str_length(*err_msg)) {
+				cyx_str_append_lit(err_msg, "ERROR:\tUnexpected operator!\n");
+			}
+			return NULL;
 		}
 
 		BindingPower bp = infix_bp(op->operator.op_type);
@@ -857,27 +888,208 @@ stop:
 	return lhs;
 }
 
-static void node_to_file(Node* node, VariableKV* vars, const char* file_path) {
+// `(x(u, v), y(u, v), z(u, v))`, returns 1 for such a tuple, 0 when the input is something else and -1 on an error inside of one
+static int parse_surface(Lexer* lex, Node* parts[3], char** err_msg) {
+	Token* t = lexer_peek(lex);
+	if (t->type != TOKEN_OPERATOR || t->operator.op_type != '(') { return 0; }
+	lexer_next(lex);
+
+	// a plain expression can start with a parentheses too, then it just gets parsed again from the start
+	char* trial_err = cyx_str_new(NULL);
+	parts[0] = parse_expr(lex, &trial_err);
+	cyx_str_free(trial_err);
+	Token* next = parts[0] ? lexer_peek(lex) : NULL;
+	if (!next || next->type != TOKEN_OPERATOR || next->operator.op_type != ',') {
+		lex->curr_token = 0;
+		return 0;
+	}
+
+	for (size_t i = 1; i < 3; ++i) {
+		lexer_next(lex);
+		parts[i] = parse_expr(lex, err_msg);
+		if (!parts[i]) { return -1; }
+
+		next = lexer_peek(lex);
+		if (next->type != TOKEN_OPERATOR || next->operator.op_type != (i < 2 ? ',' : ')')) {
+			if (err_msg) {
+				cyx_str_append_lit(err_msg, "ERROR:\tA parametric surface needs exactly three coordinates!\n");
+			}
+			return -1;
+		}
+	}
+	lexer_next(lex);
+
+	if (lexer_peek(lex)->type != TOKEN_EOF) {
+		if (err_msg) {
+			cyx_str_append_lit(err_msg, "ERROR:\tUnexpected input after the parametric surface!\n");
+		}
+		return -1;
+	}
+	return 1;
+}
+
+static Node* node_strip_parens(Node* node);
+// `f = c1, c2, ...` asks for several level sets of f, returns how many were listed (0 without a `=`) or -1 on an error
+static int parse_levels(Lexer* lex, double levels[FORMULA_MAX_LEVELS], char** err_msg) {
+	Token* t = lexer_peek(lex);
+	if (t->type != TOKEN_OPERATOR || t->operator.op_type != '=') { return 0; }
+
+	int count = 0;
+	do {
+		lexer_next(lex);
+		Node* level = parse_expr(lex, err_msg);
+		if (!level) { return -1; }
+
+		double sign = 1;
+		level = node_strip_parens(level);
+		if (level->type == NODE_UNOP && level->as.unop.type == UNOP_NEG) {
+			sign = -1;
+			level = node_strip_parens(level->as.unop.eq);
+		}
+		if (level->type != NODE_NUMBER) {
+			if (err_msg) {
+				cyx_str_append_lit(err_msg, "ERROR:\tThe levels after '=' have to be numbers!\n");
+			}
+			return -1;
+		}
+		if (count == FORMULA_MAX_LEVELS) {
+			if (err_msg) {
+				cyx_str_append_lit(err_msg, "ERROR:\tToo many levels after '=', at most 8 are allowed!\n");
+			}
+			return -1;
+		}
+		levels[count++] = sign * level->as.num;
+		t = lexer_peek(lex);
+	} while (t->type == TOKEN_OPERATOR && t->operator.op_type == ',');
+
+	if (t->type != TOKEN_EOF) {
+		if (err_msg) {
+			cyx_str_append_lit(err_msg, "ERROR:\tUnexpected input after the levels!\n");
+		}
+		return -1;
+	}
+	return count;
+}
+
+static int node_uses_var(Node* node, char var) {
+	switch (node->type) {
+		case NODE_VAR: return node->as.var.len == 1 && node->as.var.in.buffer[0] == var;
+		case NODE_NUMBER: return 0;
+		case NODE_UNOP: return node_uses_var(node->as.unop.eq, var);
+		case NODE_FUNC: return node_uses_var(node->as.func.eq, var);
+		case NODE_BINOP: return node_uses_var(node->as.binop.left, var) || node_uses_var(node->as.binop.right, var);
+		case NODE_TERNARY:
+			return node_uses_var(node->as.ternary.cond, var) ||
+				node_uses_var(node->as.ternary.first, var) ||
+				node_uses_var(node->as.ternary.second, var);
+		default: assert(0 && "UNREACHABLE");
+	}
+	return 0;
+}
+
+static Node* node_strip_parens(Node* node) {
+	while (node->type == NODE_UNOP && node->as.unop.type == UNOP_PAREN) {
+		node = node->as.unop.eq;
+	}
+	return node;
+}
+static int node_is_var(Node* node, char var) {
+	node = node_strip_parens(node);
+	return node->type == NODE_VAR && node->as.var.len == 1 && node->as.var.in.buffer[0] == var;
+}
+#define HEIGHT_MAX_TERMS 64
+// the terms `node` adds up with their signs, through parentheses and negations; 0 when there are too many
+static int node_collect_terms(Node* node, int8_t sign, Node** terms, int8_t* signs, size_t* count) {
+	node = node_strip_parens(node);
+	if (node->type == NODE_BINOP && (node->as.binop.type == BINOP_SUM || node->as.binop.type == BINOP_SUB)) {
+		return node_collect_terms(node->as.binop.left, sign, terms, signs, count) &&
+			node_collect_terms(node->as.binop.right, node->as.binop.type == BINOP_SUB ? -sign : sign, terms, signs, count);
+	}
+	if (node->type == NODE_UNOP && node->as.unop.type == UNOP_NEG) {
+		return node_collect_terms(node->as.unop.eq, -sign, terms, signs, count);
+	}
+	if (*count == HEIGHT_MAX_TERMS) { return 0; }
+	terms[*count] = node;
+	signs[*count] = sign;
+	++*count;
+	return 1;
+}
+// matches a sum with exactly one `z` or `-z` term and no other term using z, like `x^2 + y^2 - z`;
+// returns g with f = sign * (z - g(x, y)), built out of `pool`, or NULL for anything else
+static Node* node_height_split(EvoPool* pool, Node* root, int8_t* sign) {
+	Node* terms[HEIGHT_MAX_TERMS];
+	int8_t signs[HEIGHT_MAX_TERMS];
+	size_t count = 0;
+	if (!node_collect_terms(root, 1, terms, signs, &count)) { return NULL; }
+
+	int8_t z_sign = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (node_is_var(terms[i], 'z')) {
+			if (z_sign) { return NULL; }
+			z_sign = signs[i];
+		} else if (node_uses_var(terms[i], 'z') || !node_is_double(terms[i])) {
+			return NULL;
+		}
+	}
+	if (!z_sign) { return NULL; }
+
+	// z + r = 0 gives g = -r, r - z = 0 gives g = r, every term is kept in parentheses so the printed C stays as parsed
+	Node* g = NULL;
+	for (size_t i = 0; i < count; ++i) {
+		if (node_is_var(terms[i], 'z')) { continue; }
+		Node* term = node_paren(pool, terms[i]);
+		int8_t term_sign = z_sign > 0 ? -signs[i] : signs[i];
+		if (!g) {
+			g = term_sign > 0 ? term : node_neg(pool, term);
+		} else {
+			g = term_sign > 0 ? node_sum(pool, g, term) : node_sub(pool, g, term);
+		}
+	}
+	*sign = z_sign;
+	return g ? g : node_num(pool, 0);
+}
+
+// `node` is the implicit function, or NULL when `surface` holds the three coordinates of a parametric one
+static int node_to_file(Node* node, Node* height, Node** surface, VariableKV* vars, const char* file_path) {
 	FILE* out = fopen(file_path, "w+");
+	if (!out) { return 0; }
 
 	fprintf(out, "#include <math.h>\n\n");
 	if (vars) {
+		const char* reserved = node ? "xyzt" : "uvt";
 		cyx_hashmap_foreach(var, vars) {
-			if (var->key.len == 1 && (var->key.in.buffer[0] == 'x' || var->key.in.buffer[0] == 'y' || var->key.in.buffer[0] == 'z')) {
+			if (var->key.len == 1 && strchr(reserved, var->key.in.buffer[0])) {
 				continue;
 			}
 			fprintf(out, "static double "CYX_STR_FMT" = %lf;\n", SLICE_UNPACK(&var->key), var->value);
 		}
 	}
-	fprintf(out, "double formula_calculate(double x, double y, double z) {\n");
-	fprintf(out, "\treturn ");
-	node_print(out, node);
-	fprintf(out, ";\n");
-	fprintf(out, "}\n");
+	if (node) {
+		fprintf(out, "double formula_calculate(double x, double y, double z, double t) {\n");
+		fprintf(out, "\treturn ");
+		node_print(out, node);
+		fprintf(out, ";\n");
+		fprintf(out, "}\n");
+	} else {
+		fprintf(out, "void formula_surface(double u, double v, double t, double* out) {\n");
+		for (size_t i = 0; i < 3; ++i) {
+			fprintf(out, "\tout[%zu] = ", i);
+			node_print(out, surface[i]);
+			fprintf(out, ";\n");
+		}
+		fprintf(out, "}\n");
+	}
+	if (height) {
+		fprintf(out, "double formula_height(double x, double y, double t) {\n");
+		fprintf(out, "\treturn ");
+		node_print(out, height);
+		fprintf(out, ";\n");
+		fprintf(out, "}\n");
+	}
 	fclose(out);
+	return 1;
 }
 
-typedef double (*Func)(double x, double y, double z);
 #include <isosurfaces.h>
 /*
  *         6-------------7            +------6------+   
@@ -900,84 +1112,7 @@ static Vec3 vec3_lerp(Vec3 a, Vec3 b, double t) {
 	};
 }
 
-static void cube_marching(uint32_t** indicies, float** triangles, Func f, int res, double left, double right, double bottom, double top, double near, double far) {
-	assert(res > 0);
-
-	double w = (right - left) / res;
-	double h = (top - bottom) / res;
-	double d = (far - near) / res;
-
-	for (size_t k = 0; (int)k < res - 1; ++k) {
-		double z_0 = k * d + near;
-		double z_1 = (k + 1) * d + near;
-		for (size_t j = 0; (int)j < res - 1; ++j) {
-			double y_0 = j * h + bottom;
-			double y_1 = (j + 1) * h + bottom;
-			for (size_t i = 0; (int)i < res - 1; ++i) {
-				double x_0 = i * w + left;
-				double x_1 = (i + 1) * w + left;
-				Vec3 vecs[] = {
-					(Vec3){x_0, y_0, z_0},
-					(Vec3){x_1, y_0, z_0},
-					(Vec3){x_0, y_1, z_0},
-					(Vec3){x_1, y_1, z_0},
-					(Vec3){x_0, y_0, z_1},
-					(Vec3){x_1, y_0, z_1},
-					(Vec3){x_0, y_1, z_1},
-					(Vec3){x_1, y_1, z_1},
-				};
-
-				uint8_t mask = 0;
-				for (uint8_t count = 0; count < 8; ++count) {
-					Vec3 vec = vecs[count];
-					if (f(vec.x, vec.y, vec.z) < 0) { mask |= 0x1 << count; }
-				}
-				uint16_t edge_mask = edge_masks[mask];
-
-				uint32_t edge_ids[12] = { 0 };
-				for (size_t idx = 0; idx < 12 && edge_mask; ++idx, edge_mask >>= 1) {
-					uint8_t is_edge = edge_mask & 0b1;
-					if (!is_edge) { continue; }
-
-					const uint8_t* vertices = edge_vertex_indicies[idx];
-					
-					Vec3 vec1 = vecs[vertices[0]];
-					double val1 = f(vec1.x, vec1.y, vec1.z);
-					Vec3 vec2 = vecs[vertices[1]];
-					double val2 = f(vec2.x, vec2.y, vec2.z);
-					
-					double t = val1 / (val1 - val2);
-					Vec3 edge =  vec3_lerp(vec1, vec2, t);
-
-					int found = -1;
-					for (size_t tri = 0; tri + 5 < cyx_array_length(*triangles); tri += 6) {
-						if (fabs((*triangles)[tri + 0] - edge.x) < 1e-5 &&
-							fabs((*triangles)[tri + 1] - edge.y) < 1e-5 &&
-							fabs((*triangles)[tri + 2] - edge.z) < 1e-5) {
-							found = (int)tri;
-							break;
-						}
-					}
-					
-					if (found == -1) {
-						edge_ids[idx] = cyx_array_length(*triangles) / 6;
-						cyx_array_append_mult(*triangles, edge.x, edge.y, edge.z, 0, 0, 0);
-					} else {
-						edge_ids[idx] = found / 6;
-					}
-				}
-
-				const int8_t* arr = triangle_table[mask];
-				for (; *arr != -1; arr++) {
-					int idx = *arr;
-					cyx_array_append(*indicies, edge_ids[idx]);
-				}
-			}
-		}
-	}
-
-	assert(cyx_array_length(*triangles) % 6 == 0);
-
+static void mesh_compute_normals(uint32_t** indicies, float** triangles) {
 	for (size_t i = 0; i + 2 < cyx_array_length(*indicies); i += 3) {
 		uint32_t idx1 = (*indicies)[i];
 		uint32_t idx2 = (*indicies)[i + 1];
@@ -1038,63 +1173,1566 @@ static void cube_marching(uint32_t** indicies, float** triangles, Func f, int re
 		(*triangles)[i + 5] /= magn;
 	}
 
-	// printf("triangles[%zu] = {", cyx_array_length(*triangles));
-	// for (size_t i = 0; i < cyx_array_length(*triangles); ++i) {
-	// 	if (i % 6 == 0) printf("\n\t");
-	// 	printf("%.2f, ", (*triangles)[i]);
-	// }
-	// printf("\n}\n");
-	// printf("indices[%zu] = {", cyx_array_length(*indicies));
-	// for (size_t i = 0; i < cyx_array_length(*indicies); ++i) {
-	// 	if (i % 3 == 0) printf("\n\t");
-	// 	printf("%u, ", (*indicies)[i]);
-	// }
-	// printf("\n}\n");
 }
 
-int cube_march(uint32_t** indicies, float** triangles, char* equation, VariableKV* vars, CubeMarchDefintions defs, char** err_msg) {
-	Lexer lex = { 0 };
-	if (!lexer_lex(&lex, equation, cyx_str_length(equation), err_msg)) { return 0; }
+#define EDGE_NONE UINT32_MAX
+static void march_slab_reserve(MarchSlab* slab, size_t n) {
+	if (slab->capacity >= n) { return; }
+	for (size_t p = 0; p < 2; ++p) {
+		slab->values[p] = realloc(slab->values[p], n * sizeof(double));
+		slab->edges[p] = realloc(slab->edges[p], 3 * n * sizeof(uint32_t));
+	}
+	slab->z_edges = realloc(slab->z_edges, n * sizeof(uint32_t));
+	slab->first_edges = realloc(slab->first_edges, 3 * n * sizeof(uint32_t));
+	slab->capacity = n;
 
-	Node* root = parse_expr(&lex, err_msg);
-	if (!root) { return 0; }
+	if (!slab->indices) {
+		slab->indices = cyx_array_new(uint32_t, NULL);
+		slab->vertices = cyx_array_new(float, NULL);
+	}
+}
+static void march_slab_free(MarchSlab* slab) {
+	for (size_t p = 0; p < 2; ++p) {
+		free(slab->values[p]);
+		free(slab->edges[p]);
+	}
+	free(slab->z_edges);
+	free(slab->first_edges);
+	free(slab->remap);
+	if (slab->indices) {
+		cyx_array_free(slab->indices);
+		cyx_array_free(slab->vertices);
+	}
+	if (slab->active) {
+		cyx_array_free(slab->active);
+	}
+	*slab = (MarchSlab){ 0 };
+}
+static double volume_voxel(const Volume* volume, size_t x, size_t y, size_t z) {
+	size_t idx = (z * volume->ny + y) * volume->nx + x;
+	return volume->format == VOLUME_FLOAT32 ? ((const float*)volume->data)[idx] : ((const uint16_t*)volume->data)[idx];
+}
+// lattice point (i, j, k) of the res^3 grid stretched over the volume, samples above the iso value come out negative
+static double volume_at(const Volume* volume, uint32_t res, size_t i, size_t j, size_t k) {
+	// bricks of the sparse marcher hang over the last point of the grid
+	size_t lattice[3] = { i < res ? i : res - 1, j < res ? j : res - 1, k < res ? k : res - 1 };
+	if (volume->nx == res && volume->ny == res && volume->nz == res) {
+		return volume->iso - volume_voxel(volume, lattice[0], lattice[1], lattice[2]);
+	}
 
-	if (!node_typecheck(root)) {
-		cyx_array_clear(*indicies);
-		cyx_array_clear(*triangles);
+	size_t dims[3] = { volume->nx, volume->ny, volume->nz };
+	size_t base[3];
+	double frac[3];
+	for (size_t a = 0; a < 3; ++a) {
+		double p = (double)lattice[a] * (dims[a] - 1) / (res - 1);
+		base[a] = (size_t)p;
+		if (base[a] + 1 >= dims[a]) { base[a] = dims[a] - 2; }
+		frac[a] = p - base[a];
+	}
+	double value = 0;
+	for (uint8_t c = 0; c < 8; ++c) {
+		double weight = ((c & 1) ? frac[0] : 1 - frac[0]) * ((c & 2) ? frac[1] : 1 - frac[1]) * ((c & 4) ? frac[2] : 1 - frac[2]);
+		if (weight == 0) { continue; }
+		value += weight * volume_voxel(volume, base[0] + (c & 1), base[1] + ((c >> 1) & 1), base[2] + ((c >> 2) & 1));
+	}
+	return volume->iso - value;
+}
+static void march_sample_plane(double* values, const Field* field, CubeMarchDefintions* defs, size_t k) {
+	uint32_t res = defs->res;
+	if (field->volume) {
+		for (size_t j = 0; j < res; ++j) {
+			for (size_t i = 0; i < res; ++i) {
+				values[j * res + i] = volume_at(field->volume, res, i, j, k);
+			}
+		}
+		return;
+	}
+
+	Func f = field->func;
+	double w = (defs->right - defs->left) / res;
+	double h = (defs->top - defs->bottom) / res;
+	double d = (defs->far - defs->near) / res;
+
+	double z = k * d + defs->near;
+	for (size_t j = 0; j < res; ++j) {
+		double y = j * h + defs->bottom;
+		for (size_t i = 0; i < res; ++i) {
+			values[j * res + i] = f(i * w + defs->left, y, z, defs->t);
+		}
+	}
+}
+// every edge of the grid is owned by exactly one slot, so vertices are shared without searching for them
+static uint32_t* march_edge_slot(MarchSlab* slab, uint8_t a, uint8_t b, size_t i, size_t j, uint32_t res) {
+	size_t ai = a & 1, aj = (a >> 1) & 1, ak = (a >> 2) & 1;
+	size_t bi = b & 1, bj = (b >> 1) & 1, bk = (b >> 2) & 1;
+	if (ak != bk) {
+		return &slab->z_edges[(j + aj) * res + i + ai];
+	} else if (ai != bi) {
+		return &slab->edges[ak][(j + aj) * res + i];
+	}
+	assert(aj != bj);
+	return &slab->edges[ak][res * res + j * res + i + ai];
+}
+// a surface passing exactly through a grid point gives the same vertex on all of its edges
+static uint32_t* march_point_slot(MarchSlab* slab, uint8_t c, size_t i, size_t j, uint32_t res) {
+	return &slab->edges[(c >> 2) & 1][2 * res * res + (j + ((c >> 1) & 1)) * res + i + (c & 1)];
+}
+// marches the layer of cubes between the planes k and k + 1, the bottom plane has to be sampled already
+static void march_layer(MarchSlab* slab, const Field* field, CubeMarchDefintions* defs, size_t k) {
+	uint32_t res = defs->res;
+	size_t n = (size_t)res * res;
+	double w = (defs->right - defs->left) / res;
+	double h = (defs->top - defs->bottom) / res;
+	double d = (defs->far - defs->near) / res;
+
+	march_sample_plane(slab->values[1], field, defs, k + 1);
+	memset(slab->edges[1], 0xff, 3 * n * sizeof(uint32_t));
+	memset(slab->z_edges, 0xff, n * sizeof(uint32_t));
+
+	for (size_t j = 0; j + 1 < res; ++j) {
+		for (size_t i = 0; i + 1 < res; ++i) {
+			double corners[8];
+			uint8_t mask = 0;
+			for (uint8_t c = 0; c < 8; ++c) {
+				corners[c] = slab->values[(c >> 2) & 1][(j + ((c >> 1) & 1)) * res + i + (c & 1)];
+				if (corners[c] < 0) { mask |= 0x1 << c; }
+			}
+			uint16_t edge_mask = edge_masks[mask];
+			if (!edge_mask) { continue; }
+
+			uint32_t edge_ids[12] = { 0 };
+			for (size_t idx = 0; idx < 12 && edge_mask; ++idx, edge_mask >>= 1) {
+				if (!(edge_mask & 0b1)) { continue; }
+
+				const uint8_t* vertices = edge_vertex_indicies[idx];
+				uint8_t a = vertices[0], b = vertices[1];
+				uint32_t* slot = corners[a] == 0 ? march_point_slot(slab, a, i, j, res) :
+					corners[b] == 0 ? march_point_slot(slab, b, i, j, res) :
+					march_edge_slot(slab, a, b, i, j, res);
+				if (*slot == EDGE_NONE) {
+					Vec3 vec1 = { (i + (a & 1)) * w + defs->left, (j + ((a >> 1) & 1)) * h + defs->bottom, (k + ((a >> 2) & 1)) * d + defs->near };
+					Vec3 vec2 = { (i + (b & 1)) * w + defs->left, (j + ((b >> 1) & 1)) * h + defs->bottom, (k + ((b >> 2) & 1)) * d + defs->near };
+					double t = corners[a] / (corners[a] - corners[b]);
+					Vec3 edge = vec3_lerp(vec1, vec2, t);
+
+					*slot = slab->vertex_base + cyx_array_length(slab->vertices) / 6;
+					cyx_array_append_mult(slab->vertices, edge.x, edge.y, edge.z, 0, 0, 0);
+				}
+				edge_ids[idx] = *slot;
+			}
+
+			const int8_t* arr = triangle_table[mask];
+			for (; *arr != -1; arr++) {
+				cyx_array_append(slab->indices, edge_ids[(int)*arr]);
+			}
+		}
+	}
+
+	double* values = slab->values[0];
+	slab->values[0] = slab->values[1];
+	slab->values[1] = values;
+	uint32_t* edges = slab->edges[0];
+	slab->edges[0] = slab->edges[1];
+	slab->edges[1] = edges;
+}
+static int march_slab(MarchSlab* slab, const Field* field, CubeMarchDefintions* defs, CancelToken* cancel) {
+	size_t n = (size_t)defs->res * defs->res;
+	march_slab_reserve(slab, n);
+	cyx_array_clear(slab->indices);
+	cyx_array_clear(slab->vertices);
+
+	march_sample_plane(slab->values[0], field, defs, slab->k_begin);
+	memset(slab->edges[0], 0xff, 3 * n * sizeof(uint32_t));
+	for (size_t k = slab->k_begin; k < slab->k_end; ++k) {
+		if (cancel_token_is_set(cancel)) { return 0; }
+
+		march_layer(slab, field, defs, k);
+		if (k == slab->k_begin) {
+			// the bottom plane of the first layer got swapped to the back
+			memcpy(slab->first_edges, slab->edges[1], 3 * n * sizeof(uint32_t));
+		}
+	}
+	return 1;
+}
+// glues the slabs together, vertices on the plane shared by two slabs are kept only once
+static void march_merge(MarchSlab* slabs, uint32_t count, uint32_t res, uint32_t** indicies, float** triangles) {
+	size_t n = (size_t)res * res;
+	cyx_array_clear(*indicies);
+	cyx_array_clear(*triangles);
+
+	for (uint32_t s = 0; s < count; ++s) {
+		MarchSlab* slab = &slabs[s];
+		size_t vertex_count = cyx_array_length(slab->vertices) / 6;
+		if (slab->remap_capacity < vertex_count) {
+			slab->remap = realloc(slab->remap, vertex_count * sizeof(uint32_t));
+			slab->remap_capacity = vertex_count;
+		}
+		memset(slab->remap, 0xff, vertex_count * sizeof(uint32_t));
+
+		if (s > 0) {
+			MarchSlab* below = &slabs[s - 1];
+			// after the last layer the top plane of a slab is left in edges[0]
+			for (size_t e = 0; e < 3 * n; ++e) {
+				uint32_t id = slab->first_edges[e];
+				uint32_t shared = below->edges[0][e];
+				if (id != EDGE_NONE && shared != EDGE_NONE) {
+					slab->remap[id] = below->remap[shared];
+				}
+			}
+		}
+		for (size_t v = 0; v < vertex_count; ++v) {
+			if (slab->remap[v] != EDGE_NONE) { continue; }
+			slab->remap[v] = cyx_array_length(*triangles) / 6;
+			cyx_array_append_mult_n(*triangles, 6, &slab->vertices[6 * v]);
+		}
+		for (size_t idx = 0; idx < cyx_array_length(slab->indices); ++idx) {
+			cyx_array_append(*indicies, slab->remap[slab->indices[idx]]);
+		}
+	}
+}
+static void march_partition(MarchSlab* slabs, uint32_t count, uint32_t layers) {
+	for (uint32_t s = 0; s < count; ++s) {
+		slabs[s].k_begin = layers * s / count;
+		slabs[s].k_end = layers * (s + 1) / count;
+	}
+}
+
+static void* marcher_loop(void* arg) {
+	MarcherThread* thread = arg;
+	Marcher* marcher = thread->marcher;
+
+	uint32_t seen = 0;
+	pthread_mutex_lock(&marcher->lock);
+	for (;;) {
+		while (marcher->round == seen && !marcher->quit) {
+			pthread_cond_wait(&marcher->start, &marcher->lock);
+		}
+		if (marcher->quit) { break; }
+		seen = marcher->round;
+
+		int active = thread->slab < marcher->slab_count;
+		pthread_mutex_unlock(&marcher->lock);
+		if (active) {
+			MarchSlab* slab = &marcher->slabs[thread->slab];
+			slab->done = marcher->task(marcher, slab);
+		}
+		pthread_mutex_lock(&marcher->lock);
+		if (active && --marcher->running == 0) {
+			pthread_cond_signal(&marcher->finished);
+		}
+	}
+	pthread_mutex_unlock(&marcher->lock);
+	return NULL;
+}
+static void marcher_init(Marcher* marcher, uint32_t thread_count) {
+	*marcher = (Marcher){ .thread_count = thread_count };
+	pthread_mutex_init(&marcher->lock, NULL);
+	pthread_cond_init(&marcher->start, NULL);
+	pthread_cond_init(&marcher->finished, NULL);
+	for (uint32_t i = 0; i < marcher->thread_count; ++i) {
+		marcher->threads[i] = (MarcherThread){ .marcher = marcher, .slab = i + 1 };
+		pthread_create(&marcher->threads[i].thread, NULL, marcher_loop, &marcher->threads[i]);
+	}
+}
+void marcher_start(Marcher* marcher) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	// the thread calling marcher_run marches the first slab itself
+	uint32_t thread_count = cpus > 1 ? (uint32_t)cpus - 1 : 0;
+	if (thread_count > MARCHER_MAX_THREADS - 1) {
+		thread_count = MARCHER_MAX_THREADS - 1;
+	}
+	marcher_init(marcher, thread_count);
+}
+// splits `layers` rows of work over the slabs and runs `task` on all of them, the caller takes the first one
+static int marcher_dispatch(Marcher* marcher, MarcherTask task, uint32_t layers) {
+	pthread_mutex_lock(&marcher->lock);
+	marcher->task = task;
+	marcher->slab_count = marcher->thread_count + 1;
+	if (marcher->slab_count > layers) {
+		marcher->slab_count = layers;
+	}
+	march_partition(marcher->slabs, marcher->slab_count, layers);
+	marcher->running = marcher->slab_count - 1;
+	marcher->round++;
+	pthread_cond_broadcast(&marcher->start);
+	pthread_mutex_unlock(&marcher->lock);
+
+	marcher->slabs[0].done = task(marcher, &marcher->slabs[0]);
+
+	pthread_mutex_lock(&marcher->lock);
+	while (marcher->running) {
+		pthread_cond_wait(&marcher->finished, &marcher->lock);
+	}
+	pthread_mutex_unlock(&marcher->lock);
+
+	for (uint32_t s = 0; s < marcher->slab_count; ++s) {
+		if (!marcher->slabs[s].done) { return 0; }
+	}
+	return 1;
+}
+
+static int march_task(Marcher* marcher, MarchSlab* slab) {
+	return march_slab(slab, &marcher->field, &marcher->defs, marcher->cancel);
+}
+int marcher_run(Marcher* marcher, uint32_t** indicies, float** triangles, Field field, CubeMarchDefintions defs, CancelToken* cancel) {
+	assert(defs.res > 1);
+
+	if (!marcher) {
+		Marcher local;
+		marcher_init(&local, 0);
+		int done = marcher_run(&local, indicies, triangles, field, defs, cancel);
+		marcher_stop(&local);
+		return done;
+	}
+
+	marcher->field = field;
+	marcher->defs = defs;
+	marcher->cancel = cancel;
+	if (!marcher_dispatch(marcher, march_task, defs.res - 1)) { return 0; }
+
+	march_merge(marcher->slabs, marcher->slab_count, defs.res, indicies, triangles);
+	mesh_compute_normals(indicies, triangles);
+	return 1;
+}
+
+static int height_task(Marcher* marcher, MarchSlab* slab) {
+	CubeMarchDefintions* defs = &marcher->defs;
+	uint32_t res = defs->res;
+	double w = (defs->right - defs->left) / res;
+	double h = (defs->top - defs->bottom) / res;
+
+	for (size_t j = slab->k_begin; j < slab->k_end; ++j) {
+		if (cancel_token_is_set(marcher->cancel)) { return 0; }
+
+		double y = j * h + defs->bottom;
+		for (size_t i = 0; i < res; ++i) {
+			marcher->heights[j * res + i] = marcher->height(i * w + defs->left, y, defs->t);
+		}
+	}
+	return 1;
+}
+static int height_valid(double z, CubeMarchDefintions* defs) {
+	return isfinite(z) && z >= defs->near && z <= defs->far;
+}
+// central difference where both neighbours exist, one sided on the border
+static double height_slope(double* heights, size_t at, size_t stride, size_t pos, uint32_t res, double step, CubeMarchDefintions* defs) {
+	double z = heights[at];
+	int prev = pos > 0 && height_valid(heights[at - stride], defs);
+	int next = pos + 1 < res && height_valid(heights[at + stride], defs);
+	if (prev && next) {
+		return (heights[at + stride] - heights[at - stride]) / (2 * step);
+	} else if (next) {
+		return (heights[at + stride] - z) / step;
+	} else if (prev) {
+		return (z - heights[at - stride]) / step;
+	}
+	return 0;
+}
+int heightfield_run(Marcher* marcher, uint32_t** indicies, float** triangles, HeightFunc g, int8_t sign, CubeMarchDefintions defs, CancelToken* cancel) {
+	assert(defs.res > 1);
+
+	if (!marcher) {
+		Marcher local;
+		marcher_init(&local, 0);
+		int done = heightfield_run(&local, indicies, triangles, g, sign, defs, cancel);
+		marcher_stop(&local);
+		return done;
+	}
+
+	uint32_t res = defs.res;
+	size_t n = (size_t)res * res;
+	if (marcher->height_capacity < n) {
+		marcher->heights = realloc(marcher->heights, n * sizeof(double));
+		marcher->height_ids = realloc(marcher->height_ids, n * sizeof(uint32_t));
+		marcher->height_capacity = n;
+	}
+
+	marcher->height = g;
+	marcher->defs = defs;
+	marcher->cancel = cancel;
+	if (!marcher_dispatch(marcher, height_task, res)) { return 0; }
+
+	double w = (defs.right - defs.left) / res;
+	double h = (defs.top - defs.bottom) / res;
+	double* heights = marcher->heights;
+	uint32_t* ids = marcher->height_ids;
+
+	cyx_array_clear(*indicies);
+	cyx_array_clear(*triangles);
+	for (size_t j = 0; j < res; ++j) {
+		if (cancel_token_is_set(cancel)) { return 0; }
+
+		for (size_t i = 0; i < res; ++i) {
+			size_t at = j * res + i;
+			if (!height_valid(heights[at], &defs)) {
+				ids[at] = EDGE_NONE;
+				continue;
+			}
+
+			// the gradient of z - g(x, y)
+			double gx = height_slope(heights, at, 1, i, res, w, &defs);
+			double gy = height_slope(heights, at, res, j, res, h, &defs);
+			double magn = sqrt(gx * gx + gy * gy + 1);
+
+			ids[at] = cyx_array_length(*triangles) / 6;
+			cyx_array_append_mult(*triangles,
+				i * w + defs.left, j * h + defs.bottom, heights[at],
+				sign * -gx / magn, sign * -gy / magn, sign / magn
+			);
+		}
+	}
+	for (size_t j = 0; j + 1 < res; ++j) {
+		for (size_t i = 0; i + 1 < res; ++i) {
+			uint32_t a = ids[j * res + i];
+			uint32_t b = ids[j * res + i + 1];
+			uint32_t c = ids[(j + 1) * res + i + 1];
+			uint32_t d = ids[(j + 1) * res + i];
+			if (a == EDGE_NONE || b == EDGE_NONE || c == EDGE_NONE || d == EDGE_NONE) { continue; }
+
+			// counter clockwise seen from the side the normals point to
+			if (sign > 0) {
+				cyx_array_append_mult(*indicies, a, b, c, a, c, d);
+			} else {
+				cyx_array_append_mult(*indicies, a, c, b, a, d, c);
+			}
+		}
+	}
+	return 1;
+}
+#define field_level_count(field) ((field)->level_count ? (field)->level_count : 1)
+#define field_level(field, l) ((field)->level_count ? (field)->levels[l] : 0.0)
+#define COARSE_STEP (BRICK_SIZE / 2)
+#define brick_key(bx, by, bz) ((uint32_t)(bz) << 20 | (uint32_t)(by) << 10 | (uint32_t)(bx))
+static void coarse_sample_plane(double* values, const Field* field, CubeMarchDefintions* defs, size_t cz, size_t cn) {
+	uint32_t res = defs->res;
+	double w = (defs->right - defs->left) / res;
+	double h = (defs->top - defs->bottom) / res;
+	double d = (defs->far - defs->near) / res;
+
+	#define coarse_to_fine(c) ((c) * COARSE_STEP < res - 1 ? (c) * COARSE_STEP : res - 1)
+	if (field->volume) {
+		for (size_t cy = 0; cy < cn; ++cy) {
+			for (size_t cx = 0; cx < cn; ++cx) {
+				values[cy * cn + cx] = volume_at(field->volume, res, coarse_to_fine(cx), coarse_to_fine(cy), coarse_to_fine(cz));
+			}
+		}
+		return;
+	}
+	Func f = field->func;
+	double z = coarse_to_fine(cz) * d + defs->near;
+	for (size_t cy = 0; cy < cn; ++cy) {
+		double y = coarse_to_fine(cy) * h + defs->bottom;
+		for (size_t cx = 0; cx < cn; ++cx) {
+			values[cy * cn + cx] = f(coarse_to_fine(cx) * w + defs->left, y, z, defs->t);
+		}
+	}
+	#undef coarse_to_fine
+}
+// how much the field may change between a coarse sample and any point up to half a coarse step away,
+// judged from the largest steps of the field along each axis in and around the cell (a local lipschitz estimate)
+#define COARSE_LIPSCHITZ_SAFETY 1.5
+// planes[1] and planes[2] hold the bottom and the top of the cell, planes[0] and planes[3] the ones past them (NULL outside)
+static double coarse_variation(double* const planes[4], size_t cn, size_t cx, size_t cy) {
+	double steps[3] = { 0 };
+	#define coarse_step(axis, a, b) do { \
+		double step = fabs((a) - (b)); \
+		if (step > steps[axis]) { steps[axis] = step; } \
+	} while (0)
+	for (size_t k = 1; k < 3; ++k) {
+		const double* plane = planes[k];
+		for (size_t j = cy; j < cy + 2; ++j) {
+			// the cell's own edge and the ones on both sides of it along x
+			for (size_t i = cx ? cx - 1 : 0; i <= cx + 1 && i + 1 < cn; ++i) {
+				coarse_step(0, plane[j * cn + i + 1], plane[j * cn + i]);
+			}
+		}
+		for (size_t i = cx; i < cx + 2; ++i) {
+			for (size_t j = cy ? cy - 1 : 0; j <= cy + 1 && j + 1 < cn; ++j) {
+				coarse_step(1, plane[(j + 1) * cn + i], plane[j * cn + i]);
+			}
+		}
+	}
+	for (size_t j = cy; j < cy + 2; ++j) {
+		for (size_t i = cx; i < cx + 2; ++i) {
+			for (size_t k = 0; k < 3; ++k) {
+				if (!planes[k] || !planes[k + 1]) { continue; }
+				coarse_step(2, planes[k + 1][j * cn + i], planes[k][j * cn + i]);
+			}
+		}
+	}
+	#undef coarse_step
+	// per axis no point of the cell is more than half a step from the nearest corner
+	return COARSE_LIPSCHITZ_SAFETY * (steps[0] + steps[1] + steps[2]) / 2;
+}
+// a lattice at half the brick size, every cell of it the surface may pass through wakes up the brick it lies in;
+// a part of the surface still slips through when it is thinner than the coarse step and the field does not
+// change by more than its distance to the level anywhere near it on the lattice
+static int coarse_task(Marcher* marcher, MarchSlab* slab) {
+	uint32_t res = marcher->defs.res;
+	size_t cn = (res - 1 + COARSE_STEP - 1) / COARSE_STEP + 1;
+	size_t bn = (res - 1 + BRICK_SIZE - 1) / BRICK_SIZE;
+	// each of the two value buffers holds two planes
+	march_slab_reserve(slab, 2 * cn * cn);
+	if (!slab->active) {
+		slab->active = cyx_array_new(uint32_t, NULL);
+	}
+	cyx_array_clear(slab->active);
+
+	double* ring[4] = { slab->values[0], slab->values[0] + cn * cn, slab->values[1], slab->values[1] + cn * cn };
+	double* planes[4] = { 0 };
+	for (size_t p = 0; p < 4; ++p) {
+		int64_t cz = (int64_t)slab->k_begin + p - 1;
+		if (cz < 0 || (size_t)cz >= cn) { continue; }
+		planes[p] = ring[p];
+		coarse_sample_plane(planes[p], &marcher->field, &marcher->defs, cz, cn);
+	}
+	for (size_t cz = slab->k_begin; cz < slab->k_end; ++cz) {
+		if (cancel_token_is_set(marcher->cancel)) { return 0; }
+
+		for (size_t cy = 0; cy + 1 < cn; ++cy) {
+			for (size_t cx = 0; cx + 1 < cn; ++cx) {
+				int woken = 0;
+				double variation = -1;
+				for (uint32_t l = 0; l < field_level_count(&marcher->field) && !woken; ++l) {
+					double level = field_level(&marcher->field, l);
+					uint8_t inside = 0;
+					double nearest = INFINITY;
+					for (uint8_t c = 0; c < 8; ++c) {
+						double value = planes[1 + ((c >> 2) & 1)][(cy + ((c >> 1) & 1)) * cn + cx + (c & 1)];
+						inside += value < level;
+						if (fabs(value - level) < nearest) { nearest = fabs(value - level); }
+					}
+					woken = inside != 0 && inside != 8;
+					if (!woken) {
+						if (variation < 0) { variation = coarse_variation(planes, cn, cx, cy); }
+						woken = nearest <= variation;
+					}
+				}
+				if (!woken) { continue; }
+
+				// a coarse cell touches the faces of the bricks around its nearer corner, and the surface may slip
+				// across those faces in between the coarse samples, so those bricks are woken up too
+				for (uint8_t c = 0; c < 8; ++c) {
+					int64_t bx = (int64_t)(cx + ((c & 1) ? 2 * (cx & 1) - 1 : 0) + 2) / 2 - 1;
+					int64_t by = (int64_t)(cy + ((c & 2) ? 2 * (cy & 1) - 1 : 0) + 2) / 2 - 1;
+					int64_t bz = (int64_t)(cz + ((c & 4) ? 2 * (cz & 1) - 1 : 0) + 2) / 2 - 1;
+					if (bx < 0 || by < 0 || bz < 0 || (size_t)bx >= bn || (size_t)by >= bn || (size_t)bz >= bn) { continue; }
+					uint32_t key = brick_key(bx, by, bz);
+					if (!cyx_array_length(slab->active) || *cyx_array_top(slab->active) != key) {
+						cyx_array_append(slab->active, key);
+					}
+				}
+			}
+		}
+
+		// the plane that falls off the bottom takes the next one past the top
+		double* spare = ring[0];
+		for (size_t p = 0; p < 3; ++p) {
+			ring[p] = ring[p + 1];
+			planes[p] = planes[p + 1];
+		}
+		ring[3] = spare;
+		planes[3] = NULL;
+		if (cz + 3 < cn) {
+			planes[3] = ring[3];
+			coarse_sample_plane(planes[3], &marcher->field, &marcher->defs, cz + 3, cn);
+		}
+	}
+	return 1;
+}
+static int brick_task(Marcher* marcher, MarchSlab* slab) {
+	CubeMarchDefintions* defs = &marcher->defs;
+	uint32_t res = defs->res;
+	double w = (defs->right - defs->left) / res;
+	double h = (defs->top - defs->bottom) / res;
+	double d = (defs->far - defs->near) / res;
+
+	for (size_t b = slab->k_begin; b < slab->k_end; ++b) {
+		if (cancel_token_is_set(marcher->cancel)) { return 0; }
+
+		Brick* brick = marcher->bricks[b];
+		double* values = brick->values;
+		if (marcher->field.volume) {
+			for (size_t z = 0; z < BRICK_SIDE; ++z) {
+				for (size_t y = 0; y < BRICK_SIDE; ++y) {
+					for (size_t x = 0; x < BRICK_SIDE; ++x) {
+						*values++ = volume_at(marcher->field.volume, res,
+							brick->bx * BRICK_SIZE + x, brick->by * BRICK_SIZE + y, brick->bz * BRICK_SIZE + z);
+					}
+				}
+			}
+			continue;
+		}
+		for (size_t z = 0; z < BRICK_SIDE; ++z) {
+			double pz = (brick->bz * BRICK_SIZE + z) * d + defs->near;
+			for (size_t y = 0; y < BRICK_SIDE; ++y) {
+				double py = (brick->by * BRICK_SIZE + y) * h + defs->bottom;
+				for (size_t x = 0; x < BRICK_SIDE; ++x) {
+					*values++ = marcher->field.func((brick->bx * BRICK_SIZE + x) * w + defs->left, py, pz, defs->t);
+				}
+			}
+		}
+	}
+	return 1;
+}
+// empties an arena for the next run, one that had to grow gets replaced by a single block of the size it grew to
+static void arena_recycle(EvoArena* arena, size_t initial_size) {
+	if (!arena->buffer) {
+		*arena = evo_arena_new(initial_size);
+	} else if (arena->next) {
+		size_t size = evo_arena_size(arena);
+		evo_arena_destroy(arena);
+		*arena = evo_arena_new(size);
+	} else {
+		evo_arena_reset(arena);
+	}
+}
+static void brick_arena_recycle(Marcher* marcher) {
+	if (!marcher->brick_arena.buffer) {
+		marcher->bricks = cyx_array_new(Brick*, NULL);
+		marcher->brick_edges = malloc(4 * BRICK_POINTS * sizeof(uint32_t));
+	}
+	arena_recycle(&marcher->brick_arena, 1 << 20);
+	cyx_array_clear(marcher->bricks);
+}
+static GridKV* grid_table_new(EvoArena* arena, size_t capacity) {
+	GridKV* table = evo_arena_malloc(arena, capacity * sizeof(GridKV));
+	memset(table, 0xff, capacity * sizeof(GridKV));
+	return table;
+}
+// linear probing, `capacity` is a power of two and the table is kept at most half full
+static GridKV* grid_table_slot(GridKV* table, size_t capacity, uint64_t key) {
+	size_t pos = (key * 0x9e3779b97f4a7c15ull) >> 17;
+	for (;; ++pos) {
+		GridKV* slot = &table[pos & (capacity - 1)];
+		if (slot->key == key || slot->key == GRID_KEY_NONE) { return slot; }
+	}
+}
+static void edge_table_grow(Marcher* marcher) {
+	GridKV* old = marcher->edge_table;
+	size_t capacity = marcher->edge_capacity;
+	marcher->edge_capacity *= 2;
+	marcher->edge_table = grid_table_new(&marcher->brick_arena, marcher->edge_capacity);
+	for (size_t i = 0; i < capacity; ++i) {
+		if (old[i].key == GRID_KEY_NONE) { continue; }
+		*grid_table_slot(marcher->edge_table, marcher->edge_capacity, old[i].key) = old[i];
+	}
+}
+// same as march_edge_slot and march_point_slot, but the vertices on the faces of a brick are also looked up by their place in the whole grid
+static uint32_t sparse_vertex(Marcher* marcher, Brick* brick, uint32_t level, double* corners, uint8_t a, uint8_t b, size_t x, size_t y, size_t z, float** triangles) {
+	CubeMarchDefintions* defs = &marcher->defs;
+	uint32_t res = defs->res;
+
+	uint8_t point = corners[a] == 0 ? a : corners[b] == 0 ? b : 8;
+	size_t lx, ly, lz, axis;
+	if (point < 8) {
+		lx = x + (point & 1); ly = y + ((point >> 1) & 1); lz = z + ((point >> 2) & 1);
+		axis = 3;
+	} else {
+		lx = x + ((a & b) & 1); ly = y + (((a & b) >> 1) & 1); lz = z + (((a & b) >> 2) & 1);
+		axis = (a ^ b) == 1 ? 0 : (a ^ b) == 2 ? 1 : 2;
+	}
+
+	uint32_t* slot = &marcher->brick_edges[((lz * BRICK_SIDE + ly) * BRICK_SIDE + lx) * 4 + axis];
+	if (*slot != EDGE_NONE) { return *slot; }
+
+	// an edge never crosses the faces perpendicular to it, it can only lie in the others
+	#define brick_bound(l) ((l) == 0 || (l) == BRICK_SIZE)
+	int on_face = (axis != 0 && brick_bound(lx)) || (axis != 1 && brick_bound(ly)) || (axis != 2 && brick_bound(lz));
+	#undef brick_bound
+
+	uint64_t grid_key = 0;
+	if (on_face) {
+		uint64_t gx = brick->bx * BRICK_SIZE + lx, gy = brick->by * BRICK_SIZE + ly, gz = brick->bz * BRICK_SIZE + lz;
+		grid_key = (((gz * res + gy) * res + gx) * 4 + axis) * FORMULA_MAX_LEVELS + level;
+		GridKV* found = grid_table_slot(marcher->edge_table, marcher->edge_capacity, grid_key);
+		if (found->key != GRID_KEY_NONE) {
+			*slot = found->value;
+			return *slot;
+		}
+	}
+
+	double w = (defs->right - defs->left) / res;
+	double h = (defs->top - defs->bottom) / res;
+	double d = (defs->far - defs->near) / res;
+	size_t gx = brick->bx * BRICK_SIZE + x, gy = brick->by * BRICK_SIZE + y, gz = brick->bz * BRICK_SIZE + z;
+	Vec3 vec1 = { (gx + (a & 1)) * w + defs->left, (gy + ((a >> 1) & 1)) * h + defs->bottom, (gz + ((a >> 2) & 1)) * d + defs->near };
+	Vec3 vec2 = { (gx + (b & 1)) * w + defs->left, (gy + ((b >> 1) & 1)) * h + defs->bottom, (gz + ((b >> 2) & 1)) * d + defs->near };
+	double t = corners[a] / (corners[a] - corners[b]);
+	Vec3 edge = vec3_lerp(vec1, vec2, t);
+
+	*slot = cyx_array_length(*triangles) / 6;
+	cyx_array_append_mult(*triangles, edge.x, edge.y, edge.z, 0, 0, 0);
+	if (on_face) {
+		if (2 * ++marcher->edge_count > marcher->edge_capacity) {
+			edge_table_grow(marcher);
+		}
+		*grid_table_slot(marcher->edge_table, marcher->edge_capacity, grid_key) = (GridKV){ grid_key, *slot };
+	}
+	return *slot;
+}
+typedef double BrickRow __attribute__((vector_size(BRICK_SIZE * sizeof(double))));
+typedef int64_t BrickMask __attribute__((vector_size(BRICK_SIZE * sizeof(int64_t))));
+// cube masks of a whole row of cells at once, from the four rows of samples around it
+static void brick_row_masks(BrickMask* out, double* values, double level, size_t y, size_t z) {
+	BrickMask masks = { 0 };
+	BrickRow levels = (BrickRow){ 0 } + level;
+	for (uint8_t c = 0; c < 8; c += 2) {
+		double* row = &values[((z + ((c >> 2) & 1)) * BRICK_SIDE + y + ((c >> 1) & 1)) * BRICK_SIDE];
+		BrickRow lo, hi;
+		memcpy(&lo, row, sizeof(lo));
+		memcpy(&hi, row + 1, sizeof(hi));
+		masks |= (lo < levels) & (1 << c);
+		masks |= (hi < levels) & (1 << (c + 1));
+	}
+	*out = masks;
+}
+static void sparse_march_brick(Marcher* marcher, Brick* brick, uint32_t l, uint32_t** indicies, float** triangles) {
+	uint32_t res = marcher->defs.res;
+	double level = field_level(&marcher->field, l);
+	memset(marcher->brick_edges, 0xff, 4 * BRICK_POINTS * sizeof(uint32_t));
+
+	for (size_t z = 0; z < BRICK_SIZE && brick->bz * BRICK_SIZE + z + 1 < res; ++z) {
+		for (size_t y = 0; y < BRICK_SIZE && brick->by * BRICK_SIZE + y + 1 < res; ++y) {
+			BrickMask masks;
+			brick_row_masks(&masks, brick->values, level, y, z);
+
+			for (size_t x = 0; x < BRICK_SIZE && brick->bx * BRICK_SIZE + x + 1 < res; ++x) {
+				uint8_t mask = masks[x];
+				uint16_t edge_mask = edge_masks[mask];
+				if (!edge_mask) { continue; }
+
+				double corners[8];
+				for (uint8_t c = 0; c < 8; ++c) {
+					corners[c] = brick->values[((z + ((c >> 2) & 1)) * BRICK_SIDE + y + ((c >> 1) & 1)) * BRICK_SIDE + x + (c & 1)] - level;
+				}
+
+				uint32_t edge_ids[12] = { 0 };
+				for (size_t idx = 0; idx < 12 && edge_mask; ++idx, edge_mask >>= 1) {
+					if (!(edge_mask & 0b1)) { continue; }
+					const uint8_t* vertices = edge_vertex_indicies[idx];
+					edge_ids[idx] = sparse_vertex(marcher, brick, l, corners, vertices[0], vertices[1], x, y, z, triangles);
+				}
+
+				const int8_t* arr = triangle_table[mask];
+				for (; *arr != -1; arr++) {
+					cyx_array_append(*indicies, edge_ids[(int)*arr]);
+				}
+			}
+		}
+	}
+}
+int sparse_run(Marcher* marcher, uint32_t** indicies, float** triangles, MeshLevels* levels, Field field, CubeMarchDefintions defs, CancelToken* cancel) {
+	assert(defs.res > 1);
+	assert((defs.res + BRICK_SIZE - 1) / BRICK_SIZE < (1 << 10));
+
+	if (!marcher) {
+		Marcher local;
+		marcher_init(&local, 0);
+		int done = sparse_run(&local, indicies, triangles, levels, field, defs, cancel);
+		marcher_stop(&local);
+		return done;
+	}
+
+	marcher->field = field;
+	marcher->defs = defs;
+	marcher->cancel = cancel;
+	size_t cn = (defs.res - 1 + COARSE_STEP - 1) / COARSE_STEP + 1;
+	if (!marcher_dispatch(marcher, coarse_task, cn - 1)) { return 0; }
+
+	brick_arena_recycle(marcher);
+	size_t active_count = 0;
+	for (uint32_t s = 0; s < marcher->slab_count; ++s) {
+		active_count += cyx_array_length(marcher->slabs[s].active);
+	}
+	for (marcher->brick_capacity = 64; marcher->brick_capacity < 2 * active_count; marcher->brick_capacity *= 2);
+	marcher->brick_table = grid_table_new(&marcher->brick_arena, marcher->brick_capacity);
+	for (uint32_t s = 0; s < marcher->slab_count; ++s) {
+		uint32_t* active = marcher->slabs[s].active;
+		for (size_t i = 0; i < cyx_array_length(active); ++i) {
+			GridKV* slot = grid_table_slot(marcher->brick_table, marcher->brick_capacity, active[i]);
+			if (slot->key != GRID_KEY_NONE) { continue; }
+
+			Brick* brick = evo_arena_malloc(&marcher->brick_arena, sizeof(Brick));
+			brick->bx = active[i] & 0x3ff;
+			brick->by = (active[i] >> 10) & 0x3ff;
+			brick->bz = active[i] >> 20;
+			*slot = (GridKV){ active[i], cyx_array_length(marcher->bricks) };
+			cyx_array_append(marcher->bricks, brick);
+		}
+	}
+	// roughly one face vertex per face cell of every brick, the table grows past that on its own
+	size_t level_count = field_level_count(&field);
+	for (marcher->edge_capacity = 64; marcher->edge_capacity < 2 * BRICK_SIZE * BRICK_SIZE * level_count * cyx_array_length(marcher->bricks); marcher->edge_capacity *= 2);
+	marcher->edge_table = grid_table_new(&marcher->brick_arena, marcher->edge_capacity);
+	marcher->edge_count = 0;
+	if (cyx_array_length(marcher->bricks) &&
+		!marcher_dispatch(marcher, brick_task, cyx_array_length(marcher->bricks))) {
+		return 0;
+	}
+
+	cyx_array_clear(*indicies);
+	cyx_array_clear(*triangles);
+	// the bricks are sampled once, every level only classifies them again
+	for (uint32_t l = 0; l < level_count; ++l) {
+		for (size_t b = 0; b < cyx_array_length(marcher->bricks); ++b) {
+			if (cancel_token_is_set(cancel)) { return 0; }
+			sparse_march_brick(marcher, marcher->bricks[b], l, indicies, triangles);
+		}
+		if (levels) { levels->ends[l] = cyx_array_length(*indicies); }
+	}
+	if (levels) { levels->count = level_count; }
+	mesh_compute_normals(indicies, triangles);
+	return 1;
+}
+
+static int surface_task(Marcher* marcher, MarchSlab* slab) {
+	CubeMarchDefintions* defs = &marcher->defs;
+	uint32_t res = defs->res;
+	double step = SURFACE_SPAN / (res - 1);
+	double eps = step * 1e-3;
+
+	for (size_t j = slab->k_begin; j < slab->k_end; ++j) {
+		if (cancel_token_is_set(marcher->cancel)) { return 0; }
+
+		double v = j * step;
+		for (size_t i = 0; i < res; ++i) {
+			double u = i * step;
+			double p[3], u0[3], u1[3], v0[3], v1[3];
+			marcher->surface(u, v, defs->t, p);
+			marcher->surface(u - eps, v, defs->t, u0);
+			marcher->surface(u + eps, v, defs->t, u1);
+			marcher->surface(u, v - eps, defs->t, v0);
+			marcher->surface(u, v + eps, defs->t, v1);
+
+			// normal is the cross product of the partial derivatives, their scale doesn't matter
+			Vec3 du = { u1[0] - u0[0], u1[1] - u0[1], u1[2] - u0[2] };
+			Vec3 dv = { v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2] };
+			Vec3 n = {
+				.x = du.y * dv.z - du.z * dv.y,
+				.y = du.z * dv.x - du.x * dv.z,
+				.z = du.x * dv.y - du.y * dv.x,
+			};
+			double magn = sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			if (!isfinite(magn) || magn < 1e-12) {
+				n = (Vec3){ 0 };
+			} else {
+				n = (Vec3){ n.x / magn, n.y / magn, n.z / magn };
+			}
+
+			float* out = &marcher->samples[6 * (j * res + i)];
+			out[0] = p[0]; out[1] = p[1]; out[2] = p[2];
+			out[3] = n.x; out[4] = n.y; out[5] = n.z;
+		}
+	}
+	return 1;
+}
+int surface_run(Marcher* marcher, uint32_t** indicies, float** triangles, SurfaceFunc f, CubeMarchDefintions defs, CancelToken* cancel) {
+	assert(defs.res > 1);
+
+	if (!marcher) {
+		Marcher local;
+		marcher_init(&local, 0);
+		int done = surface_run(&local, indicies, triangles, f, defs, cancel);
+		marcher_stop(&local);
+		return done;
+	}
+
+	uint32_t res = defs.res;
+	size_t n = (size_t)res * res;
+	if (marcher->samples_capacity < n) {
+		marcher->samples = realloc(marcher->samples, 6 * n * sizeof(float));
+		marcher->samples_capacity = n;
+	}
+
+	marcher->surface = f;
+	marcher->defs = defs;
+	marcher->cancel = cancel;
+	if (!marcher_dispatch(marcher, surface_task, res)) { return 0; }
+
+	// the parametrization decides which way u x v points, turn it outwards from the center
+	float* samples = marcher->samples;
+	Vec3 center = { 0 };
+	for (size_t p = 0; p < n; ++p) {
+		center.x += samples[6 * p + 0] / n;
+		center.y += samples[6 * p + 1] / n;
+		center.z += samples[6 * p + 2] / n;
+	}
+	double outwards = 0;
+	for (size_t p = 0; p < n; ++p) {
+		float* s = &samples[6 * p];
+		outwards += (s[0] - center.x) * s[3] + (s[1] - center.y) * s[4] + (s[2] - center.z) * s[5];
+	}
+	float flip = outwards < 0 ? -1.f : 1.f;
+	for (size_t p = 0; p < n; ++p) {
+		float* s = &samples[6 * p];
+		if (s[3] == 0 && s[4] == 0 && s[5] == 0) {
+			// poles and other degenerate points just point away from the center
+			Vec3 d = { s[0] - center.x, s[1] - center.y, s[2] - center.z };
+			double magn = sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+			if (magn > 1e-12) {
+				s[3] = d.x / magn; s[4] = d.y / magn; s[5] = d.z / magn;
+			}
+		} else {
+			s[3] *= flip; s[4] *= flip; s[5] *= flip;
+		}
+	}
+
+	cyx_array_clear(*indicies);
+	cyx_array_clear(*triangles);
+	cyx_array_append_mult_n(*triangles, 6 * n, samples);
+	for (uint32_t j = 0; j + 1 < res; ++j) {
+		for (uint32_t i = 0; i + 1 < res; ++i) {
+			uint32_t a = j * res + i;
+			uint32_t b = j * res + i + 1;
+			uint32_t c = (j + 1) * res + i + 1;
+			uint32_t d = (j + 1) * res + i;
+			if (flip > 0) {
+				cyx_array_append_mult(*indicies, a, b, c, a, c, d);
+			} else {
+				cyx_array_append_mult(*indicies, a, c, b, a, d, c);
+			}
+		}
+	}
+	return 1;
+}
+
+static int formula_mesh(Marcher* marcher, uint32_t** indicies, float** triangles, MeshLevels* levels, Formula* formula, CubeMarchDefintions defs, CancelToken* cancel) {
+	Field field = {
+		.func = formula->func, .volume = formula->volume,
+		.levels = formula->levels, .level_count = formula->level_count,
+	};
+	// several levels can only be taken out of the bricks, a still sampled field is needed for it
+	if (!formula->surface && !formula->height && (defs.res >= SPARSE_MIN_RES || field.level_count)) {
+		assert(field.func || field.volume);
+		return sparse_run(marcher, indicies, triangles, levels, field, defs, cancel);
+	}
+
+	int done = 0;
+	if (formula->surface) {
+		done = surface_run(marcher, indicies, triangles, formula->surface, defs, cancel);
+	} else if (formula->height) {
+		done = heightfield_run(marcher, indicies, triangles, formula->height, formula->height_sign, defs, cancel);
+	} else {
+		assert(field.func || field.volume);
+		done = marcher_run(marcher, indicies, triangles, field, defs, cancel);
+	}
+	if (levels) { *levels = (MeshLevels){ .count = 1, .ends = { cyx_array_length(*indicies) } }; }
+	return done;
+}
+void marcher_stop(Marcher* marcher) {
+	pthread_mutex_lock(&marcher->lock);
+	marcher->quit = 1;
+	pthread_cond_broadcast(&marcher->start);
+	pthread_mutex_unlock(&marcher->lock);
+	for (uint32_t i = 0; i < marcher->thread_count; ++i) {
+		pthread_join(marcher->threads[i].thread, NULL);
+	}
+	for (uint32_t s = 0; s < MARCHER_MAX_THREADS; ++s) {
+		march_slab_free(&marcher->slabs[s]);
+	}
+	free(marcher->heights);
+	free(marcher->height_ids);
+	free(marcher->samples);
+	if (marcher->brick_arena.buffer) {
+		evo_arena_destroy(&marcher->brick_arena);
+		cyx_array_free(marcher->bricks);
+		free(marcher->brick_edges);
+	}
+	pthread_mutex_destroy(&marcher->lock);
+	pthread_cond_destroy(&marcher->start);
+	pthread_cond_destroy(&marcher->finished);
+}
+
+static uint32_t formula_job_counter = 0;
+int formula_job_start(FormulaJob* job, char* equation, VariableKV* vars, char** err_msg) {
+	formula_job_discard(job);
+	// the lexer looks ahead up to the terminating zero, the text of the input box does not have one
+	job->equation = cyx_str_copy_a(NULL, equation);
+	cyx_str_append_char(&job->equation, '\0');
+	job->state = FORMULA_ERROR;
+
+	Lexer lex = { 0 };
+	if (!lexer_lex(&lex, job->equation, cyx_str_length(equation), err_msg)) {
+		lexer_free(&lex);
+		return 0;
+	}
+
+	// either an implicit function in `root` or the three coordinates of a parametric surface
+	Node* root = NULL;
+	Node* surface[3] = { 0 };
+	int parametric = parse_surface(&lex, surface, err_msg);
+	if (parametric < 0) {
+		lexer_free(&lex);
+		return 0;
+	} else if (!parametric) {
+		root = parse_expr(&lex, err_msg);
+		if (!root) {
+			if (err_msg && !cyx_str_length(*err_msg)) {
+				cyx_str_append_lit(err_msg, "ERROR:\tUnable to parse the expression!\n");
+			}
+			lexer_free(&lex);
+			return 0;
+		}
+	}
+	int level_count = root ? parse_levels(&lex, job->levels, err_msg) : 0;
+	if (level_count < 0) {
+		lexer_free(&lex);
+		return 0;
+	}
+	job->level_count = level_count;
 
+	int typechecked = root ? node_typecheck(root) :
+		node_typecheck(surface[0]) && node_typecheck(surface[1]) && node_typecheck(surface[2]);
+	if (!typechecked) {
 		cyx_str_append_lit(err_msg, "ERROR:\tFound error while typechecking!\n");
+		lexer_free(&lex);
+		return 0;
+	}
+
+	// every job gets its own files so a stale compile can't overwrite a library that is still loaded
+	job->id = ++formula_job_counter;
+	snprintf(job->src_path, sizeof(job->src_path), "./build/formula_%d_%u.c", (int)getpid(), job->id);
+	snprintf(job->lib_path, sizeof(job->lib_path), "./build/libformula_%d_%u.so", (int)getpid(), job->id);
+
+	job->is_surface = parametric;
+	job->uses_time = root ? node_uses_var(root, 't') :
+		node_uses_var(surface[0], 't') || node_uses_var(surface[1], 't') || node_uses_var(surface[2], 't');
+	job->height_sign = 0;
+	// a heightfield only has the one level set
+	Node* height = root && !job->level_count ? node_height_split(&lex.pool, root, &job->height_sign) : NULL;
+	int written = node_to_file(root, height, surface, vars, job->src_path);
+	lexer_free(&lex);
+	if (!written) {
+		cyx_str_append_lit(err_msg, "ERROR:\tUnable to write the function to a file!\n");
 		return 0;
 	}
-	node_to_file(root, vars, "./build/formula.c");
 
 	pid_t pid = fork();
 	if (pid == 0) {
-		execlp("gcc", "gcc", "./build/formula.c", "-O3", "-shared", "-fPIC", "-o", "./build/libformula.so", "-lm", NULL);
+		setpgid(0, 0);
+		execlp("gcc", "gcc", job->src_path, "-O3", "-shared", "-fPIC", "-o", job->lib_path, "-lm", NULL);
+		_exit(127);
 	} else if (pid < 0) {
 		cyx_str_append_lit(err_msg, "ERROR:\tUnable to fork and compile the function!\n");
+		unlink(job->src_path);
 		return 0;
-	} else {
+	}
+
+	// set on both sides of the fork so the group exists whichever runs first,
+	// once the child has exec'd this one fails and the child's own call has done it
+	setpgid(pid, pid);
+	job->pid = pid;
+	job->state = FORMULA_COMPILING;
+	return 1;
+}
+FormulaState formula_job_poll(FormulaJob* job, int block, char** err_msg) {
+	if (job->state != FORMULA_COMPILING) { return job->state; }
 
-		int status = 0;
-		waitpid(pid, &status, 0);
-		if (WIFEXITED(status)) {
-			// printf("Child exited normally!\n");
-		} else if (WIFSIGNALED(status)) {
+	int status = 0;
+	pid_t ret = waitpid(job->pid, &status, block ? 0 : WNOHANG);
+	if (ret == 0) { return job->state; }
+
+	job->pid = 0;
+	unlink(job->src_path);
+	if (ret < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		if (ret > 0 && WIFSIGNALED(status)) {
 			psignal(WTERMSIG(status), "Exit signal");
 		}
+		cyx_str_append_lit(err_msg, "ERROR:\tUnable to compile the function!\n");
+		unlink(job->lib_path);
+		job->state = FORMULA_ERROR;
+		return job->state;
 	}
-	lexer_free(&lex);
 
-	void* handle = dlopen("./build/libformula.so", RTLD_NOW);
-	if (handle) {
-		Func formula_calculate = dlsym(handle, "formula_calculate");
-		cube_marching(indicies, triangles, formula_calculate, defs.res, defs.left, defs.right, defs.bottom, defs.top, defs.near, defs.far);
-		dlclose(handle);
-	} else {
+	void* handle = dlopen(job->lib_path, RTLD_NOW | RTLD_LOCAL);
+	unlink(job->lib_path);
+	if (!handle) {
 		cyx_str_append_lit(err_msg, "ERROR:\tUnable to open a shared object file!\n");
+		job->state = FORMULA_ERROR;
+		return job->state;
+	}
+
+	job->formula = malloc(sizeof(Formula));
+	job->formula->handle = handle;
+	job->formula->func = job->is_surface ? NULL : (Func)dlsym(handle, "formula_calculate");
+	job->formula->surface = job->is_surface ? (SurfaceFunc)dlsym(handle, "formula_surface") : NULL;
+	atomic_init(&job->formula->refs, 1);
+	job->formula->uses_time = job->uses_time;
+	job->formula->height = job->height_sign ? (HeightFunc)dlsym(handle, "formula_height") : NULL;
+	job->formula->height_sign = job->height_sign;
+	memcpy(job->formula->levels, job->levels, sizeof(job->levels));
+	job->formula->level_count = job->level_count;
+	job->formula->volume = NULL;
+	job->state = FORMULA_READY;
+	return job->state;
+}
+void formula_job_discard(FormulaJob* job) {
+	if (job->state == FORMULA_COMPILING && job->pid > 0) {
+		// gcc runs in its own process group so cc1/as/ld die with it
+		if (kill(-job->pid, SIGKILL) != 0) {
+			kill(job->pid, SIGKILL);
+		}
+		waitpid(job->pid, NULL, 0);
+		unlink(job->src_path);
+		unlink(job->lib_path);
+	}
+	if (job->formula) {
+		formula_release(job->formula);
+	}
+	if (job->equation) {
+		cyx_str_free(job->equation);
+	}
+	*job = (FormulaJob){ 0 };
+}
+
+Formula* formula_retain(Formula* formula) {
+	atomic_fetch_add(&formula->refs, 1);
+	return formula;
+}
+void formula_release(Formula* formula) {
+	if (atomic_fetch_sub(&formula->refs, 1) == 1) {
+		if (formula->volume) {
+			volume_close(formula->volume);
+			free(formula->volume);
+		} else {
+			dlclose(formula->handle);
+		}
+		free(formula);
+	}
+}
+
+int volume_open(Volume* volume, const char* path, char** err_msg) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		cyx_str_append_lit(err_msg, "ERROR:\tCould not open the volume file!\n");
+		return 0;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(VolumeHeader)) {
+		cyx_str_append_lit(err_msg, "ERROR:\tThe file is too small to be a volume!\n");
+		close(fd);
+		return 0;
+	}
+	// private and read only, the pages come straight from the page cache and the heap never sees the samples
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		cyx_str_append_lit(err_msg, "ERROR:\tCould not map the volume file!\n");
+		return 0;
+	}
+	// the marchers walk the volume plane by plane
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	VolumeHeader header;
+	memcpy(&header, map, sizeof(header));
+	size_t sample_size = header.format == VOLUME_FLOAT32 ? sizeof(float) : header.format == VOLUME_UINT16 ? sizeof(uint16_t) : 0;
+	if (memcmp(header.magic, VOLUME_MAGIC, sizeof(header.magic)) || !sample_size) {
+		cyx_str_append_lit(err_msg, "ERROR:\tThe file is not a volume!\n");
+		munmap(map, st.st_size);
+		return 0;
+	}
+	// dimensions from a broken header can make the byte count wrap around and slip under the file size
+	uint64_t bytes = 0;
+	if (header.nx < 2 || header.ny < 2 || header.nz < 2 ||
+		__builtin_mul_overflow((uint64_t)header.nx, (uint64_t)header.ny, &bytes) ||
+		__builtin_mul_overflow(bytes, (uint64_t)header.nz, &bytes) ||
+		__builtin_mul_overflow(bytes, (uint64_t)sample_size, &bytes) ||
+		bytes > (uint64_t)st.st_size - sizeof(header)) {
+		cyx_str_append_lit(err_msg, "ERROR:\tThe size of the volume does not match its file!\n");
+		munmap(map, st.st_size);
+		return 0;
+	}
+
+	*volume = (Volume){
+		.map = map,
+		.map_size = st.st_size,
+		.data = (char*)map + sizeof(header),
+		.nx = header.nx, .ny = header.ny, .nz = header.nz,
+		.format = header.format,
+		.iso = header.iso,
+	};
+	return 1;
+}
+void volume_close(Volume* volume) {
+	munmap(volume->map, volume->map_size);
+	*volume = (Volume){ 0 };
+}
+Formula* formula_from_volume(const char* path, char** err_msg) {
+	Volume volume;
+	if (!volume_open(&volume, path, err_msg)) { return NULL; }
+
+	Formula* formula = malloc(sizeof(Formula));
+	*formula = (Formula){ .volume = malloc(sizeof(Volume)) };
+	*formula->volume = volume;
+	atomic_init(&formula->refs, 1);
+	return formula;
+}
+
+int cube_march_formula(uint32_t** indicies, float** triangles, MeshLevels* levels, Formula* formula, CubeMarchDefintions defs, CancelToken* cancel) {
+	return formula_mesh(NULL, indicies, triangles, levels, formula, defs, cancel);
+}
+int cube_march(uint32_t** indicies, float** triangles, char* equation, VariableKV* vars, CubeMarchDefintions defs, char** err_msg, CancelToken* cancel) {
+	FormulaJob job = { 0 };
+	int ok = formula_job_start(&job, equation, vars, err_msg);
+	while (ok && formula_job_poll(&job, 0, err_msg) == FORMULA_COMPILING) {
+		// formula_job_discard kills gcc if the request got superseded while compiling
+		if (cancel_token_is_set(cancel)) { ok = 0; break; }
+		usleep(1000);
+	}
+
+	if (!ok || job.state != FORMULA_READY || !cube_march_formula(indicies, triangles, NULL, job.formula, defs, cancel)) {
+		cyx_array_clear(*indicies);
+		cyx_array_clear(*triangles);
+		formula_job_discard(&job);
+		return 0;
+	}
+
+	formula_job_discard(&job);
+	return 1;
+}
+
+// the vertex and face counts are only known at the end, so the header is written twice with fixed width numbers
+static void ply_write_header(FILE* file, uint32_t vertex_count, uint32_t face_count) {
+	fprintf(file,
+		"ply\n"
+		"format binary_little_endian 1.0\n"
+		"element vertex %010u\n"
+		"property float x\nproperty float y\nproperty float z\n"
+		"property float nx\nproperty float ny\nproperty float nz\n"
+		"element face %010u\n"
+		"property list uchar uint vertex_indices\n"
+		"end_header\n", vertex_count, face_count);
+}
+// the whole mesh is never in memory to average face normals over, so they come from the gradient of the field
+static void stream_gradient_normals(float* vertices, size_t from, Func f, CubeMarchDefintions* defs) {
+	double eps = fmin((defs->right - defs->left), fmin(defs->top - defs->bottom, defs->far - defs->near)) / defs->res * 1e-3;
+	for (size_t v = from; v < cyx_array_length(vertices); v += 6) {
+		double x = vertices[v], y = vertices[v + 1], z = vertices[v + 2];
+		double nx = f(x + eps, y, z, defs->t) - f(x - eps, y, z, defs->t);
+		double ny = f(x, y + eps, z, defs->t) - f(x, y - eps, z, defs->t);
+		double nz = f(x, y, z + eps, defs->t) - f(x, y, z - eps, defs->t);
+		double magn = sqrt(nx * nx + ny * ny + nz * nz);
+		if (magn < 1e-300) { continue; }
+		vertices[v + 3] = nx / magn;
+		vertices[v + 4] = ny / magn;
+		vertices[v + 5] = nz / magn;
+	}
+}
+int stream_march(const char* path, Func f, CubeMarchDefintions defs, CancelToken* cancel, atomic_uint* progress, char** err_msg) {
+	assert(defs.res > 1);
+	// written next to it and renamed once it is complete, an export that never finishes leaves no PLY behind
+	char tmp_path[512 + 8];
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+		cyx_str_append_lit(err_msg, "ERROR:\tThe export path is too long!\n");
+		return 0;
+	}
+	FILE* file = fopen(tmp_path, "wb");
+	if (!file) {
+		cyx_str_append_lit(err_msg, "ERROR:\tCould not open the export file!\n");
+		return 0;
+	}
+	// PLY wants all the vertices before the faces, so the faces wait in a temporary file until the end
+	FILE* faces = tmpfile();
+	if (!faces) {
+		cyx_str_append_lit(err_msg, "ERROR:\tCould not create a temporary file for the faces!\n");
+		fclose(file);
+		remove(tmp_path);
+		return 0;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+	setvbuf(faces, NULL, _IOFBF, 1 << 20);
+	ply_write_header(file, 0, 0);
+
+	Field field = { .func = f };
+	MarchSlab slab = { 0 };
+	size_t n = (size_t)defs.res * defs.res;
+	march_slab_reserve(&slab, n);
+	march_sample_plane(slab.values[0], &field, &defs, 0);
+	memset(slab.edges[0], 0xff, 3 * n * sizeof(uint32_t));
+
+	uint64_t face_count = 0;
+	int done = 1;
+	for (size_t k = 0; k + 1 < defs.res; ++k) {
+		if (cancel_token_is_set(cancel)) { done = 0; break; }
+
+		cyx_array_clear(slab.indices);
+		cyx_array_clear(slab.vertices);
+		march_layer(&slab, &field, &defs, k);
+		stream_gradient_normals(slab.vertices, 0, f, &defs);
+
+		// every vertex of this layer is final, the edge tables only keep their ids for the next one
+		fwrite(slab.vertices, sizeof(float), cyx_array_length(slab.vertices), file);
+		for (size_t t = 0; t + 2 < cyx_array_length(slab.indices); t += 3) {
+			uint8_t face[1 + 3 * sizeof(uint32_t)] = { 3 };
+			memcpy(face + 1, &slab.indices[t], 3 * sizeof(uint32_t));
+			fwrite(face, sizeof(face), 1, faces);
+		}
+		face_count += cyx_array_length(slab.indices) / 3;
+		if ((uint64_t)slab.vertex_base + cyx_array_length(slab.vertices) / 6 > UINT32_MAX || face_count > UINT32_MAX) {
+			cyx_str_append_lit(err_msg, "ERROR:\tThe mesh is too big for 32 bit vertex indices!\n");
+			done = 0;
+			break;
+		}
+		slab.vertex_base += cyx_array_length(slab.vertices) / 6;
+		if (progress) { atomic_store(progress, k + 1); }
+	}
+
+	if (done) {
+		char buffer[1 << 16];
+		size_t read = 0;
+		rewind(faces);
+		while ((read = fread(buffer, 1, sizeof(buffer), faces))) {
+			fwrite(buffer, 1, read, file);
+		}
+		rewind(file);
+		ply_write_header(file, slab.vertex_base, face_count);
+		if (ferror(file) || ferror(faces)) {
+			cyx_str_append_lit(err_msg, "ERROR:\tWriting the export file failed!\n");
+			done = 0;
+		}
+	}
+	march_slab_free(&slab);
+	fclose(faces);
+	if (fclose(file) && done) {
+		cyx_str_append_lit(err_msg, "ERROR:\tWriting the export file failed!\n");
+		done = 0;
+	}
+	if (done && rename(tmp_path, path)) {
+		cyx_str_append_lit(err_msg, "ERROR:\tCould not move the export file into place!\n");
+		done = 0;
+	}
+	if (!done) { remove(tmp_path); }
+	return done;
+}
+
+// animated meshes get replaced too soon for the reordering to pay off, so they are left in marching order
+static void mesh_worker_order(MeshWorker* worker) {
+	arena_recycle(&worker->order_arena, 1 << 20);
+	EvoArena* arena = &worker->order_arena;
+	uint32_t vertex_count = cyx_array_length(worker->vertices) / MESH_VERTEX_FLOATS;
+	size_t index_count = cyx_array_length(worker->indices);
+
+	worker->acmr[0] = mesh_acmr(arena, worker->indices, index_count, vertex_count, MESH_ORDER_CACHE_SIZE);
+	// every level keeps its own range, so its triangles are only ever moved inside of it
+	uint32_t begin = 0;
+	for (uint32_t l = 0; l < worker->levels.count; ++l) {
+		mesh_order_triangles(arena, worker->indices + begin, worker->levels.ends[l] - begin, worker->vertices, vertex_count, MESH_ORDER_CACHE_SIZE);
+		begin = worker->levels.ends[l];
+	}
+	if (worker->order_vertices) {
+		mesh_order_vertices(arena, worker->indices, index_count, worker->vertices, vertex_count);
+	}
+	worker->acmr[1] = mesh_acmr(arena, worker->indices, index_count, vertex_count, MESH_ORDER_CACHE_SIZE);
+}
+static void* mesh_worker_loop(void* arg) {
+	MeshWorker* worker = arg;
+
+	pthread_mutex_lock(&worker->lock);
+	for (;;) {
+		while (!worker->has_pending && !worker->quit) {
+			pthread_cond_wait(&worker->cond, &worker->lock);
+		}
+		if (worker->quit) { break; }
+
+		MeshRequest req = worker->pending;
+		worker->has_pending = 0;
+		pthread_mutex_unlock(&worker->lock);
+
+		cyx_array_clear(worker->indices);
+		cyx_array_clear(worker->vertices);
+		CancelToken token = { .latest = &worker->latest, .generation = req.generation };
+		struct timespec begin, end;
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		int done = formula_mesh(&worker->marcher, &worker->indices, &worker->vertices, &worker->levels, req.formula, req.defs, &token);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		worker->acmr[0] = worker->acmr[1] = 0;
+		// a mesh of a formula using `t` is replaced the next frame, neither the ordering nor the meshlets would pay off
+		// inside the frame budget, without meshlets the whole index buffer gets drawn
+		cyx_array_clear(worker->meshlets);
+		if (done && !req.formula->uses_time) {
+			mesh_worker_order(worker);
+			mesh_build_meshlets(&worker->meshlets, worker->indices, worker->vertices, worker->levels.count, worker->levels.ends);
+		}
+		formula_release(req.formula);
+
+		pthread_mutex_lock(&worker->lock);
+		if (done && req.generation == atomic_load(&worker->latest)) {
+			uint32_t* indices = worker->ready_indices;
+			float* vertices = worker->ready_vertices;
+			worker->ready_indices = worker->indices;
+			worker->ready_vertices = worker->vertices;
+			worker->indices = indices;
+			worker->vertices = vertices;
+			worker->ready_levels = worker->levels;
+			Meshlet* meshlets = worker->ready_meshlets;
+			worker->ready_meshlets = worker->meshlets;
+			worker->meshlets = meshlets;
+			worker->ready_acmr[0] = worker->acmr[0];
+			worker->ready_acmr[1] = worker->acmr[1];
+
+			worker->ready_generation = req.generation;
+			worker->ready_seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+			worker->has_ready = 1;
+			if (worker->notify) { worker->notify(); }
+		}
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return NULL;
+}
+void mesh_worker_start(MeshWorker* worker, void (*notify)(void)) {
+	*worker = (MeshWorker){
+		.notify = notify,
+		.indices = cyx_array_new(uint32_t, NULL),
+		.vertices = cyx_array_new(float, NULL),
+		.ready_indices = cyx_array_new(uint32_t, NULL),
+		.ready_vertices = cyx_array_new(float, NULL),
+		.meshlets = cyx_array_new(Meshlet, NULL),
+		.ready_meshlets = cyx_array_new(Meshlet, NULL),
+	};
+	atomic_init(&worker->latest, 0);
+	marcher_start(&worker->marcher);
+	pthread_mutex_init(&worker->lock, NULL);
+	pthread_cond_init(&worker->cond, NULL);
+	pthread_create(&worker->thread, NULL, mesh_worker_loop, worker);
+}
+uint32_t mesh_worker_submit(MeshWorker* worker, Formula* formula, CubeMarchDefintions defs) {
+	pthread_mutex_lock(&worker->lock);
+	// bumping the generation cancels whatever the worker is marching right now
+	uint32_t generation = atomic_fetch_add(&worker->latest, 1) + 1;
+	if (worker->has_pending) {
+		formula_release(worker->pending.formula);
+	}
+	worker->pending = (MeshRequest){
+		.formula = formula_retain(formula),
+		.defs = defs,
+		.generation = generation,
+	};
+	worker->has_pending = 1;
+	worker->has_ready = 0;
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+	return generation;
+}
+void mesh_worker_cancel(MeshWorker* worker) {
+	pthread_mutex_lock(&worker->lock);
+	atomic_fetch_add(&worker->latest, 1);
+	if (worker->has_pending) {
+		formula_release(worker->pending.formula);
+		worker->has_pending = 0;
+	}
+	worker->has_ready = 0;
+	pthread_mutex_unlock(&worker->lock);
+}
+int mesh_worker_take(MeshWorker* worker, uint32_t** indices, float** vertices, MeshLevels* levels, Meshlet** meshlets, MeshStats* stats) {
+	pthread_mutex_lock(&worker->lock);
+	int taken = worker->has_ready;
+	if (taken) {
+		uint32_t* ready_indices = worker->ready_indices;
+		float* ready_vertices = worker->ready_vertices;
+		worker->ready_indices = *indices;
+		worker->ready_vertices = *vertices;
+		*indices = ready_indices;
+		*vertices = ready_vertices;
+		if (levels) { *levels = worker->ready_levels; }
+		Meshlet* ready_meshlets = worker->ready_meshlets;
+		worker->ready_meshlets = *meshlets;
+		*meshlets = ready_meshlets;
+		if (stats) {
+			*stats = (MeshStats){
+				.seconds = worker->ready_seconds,
+				.acmr = { worker->ready_acmr[0], worker->ready_acmr[1] },
+			};
+		}
+		worker->has_ready = 0;
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return taken;
+}
+void mesh_worker_stop(MeshWorker* worker) {
+	mesh_worker_cancel(worker);
+	pthread_mutex_lock(&worker->lock);
+	worker->quit = 1;
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+	pthread_join(worker->thread, NULL);
+	marcher_stop(&worker->marcher);
+
+	cyx_array_free(worker->indices);
+	cyx_array_free(worker->vertices);
+	cyx_array_free(worker->ready_indices);
+	cyx_array_free(worker->ready_vertices);
+	cyx_array_free(worker->meshlets);
+	cyx_array_free(worker->ready_meshlets);
+	if (worker->order_arena.buffer) {
+		evo_arena_destroy(&worker->order_arena);
+	}
+	pthread_mutex_destroy(&worker->lock);
+	pthread_cond_destroy(&worker->cond);
+}
+
+static void* mesh_export_loop(void* arg) {
+	MeshExport* job = arg;
+	CancelToken cancel = { .latest = &job->latest, .generation = job->generation };
+	job->result = stream_march(job->path, job->formula->func, job->defs, &cancel, &job->layers, &job->err_msg);
+	atomic_store(&job->finished, 1);
+	if (job->notify) { job->notify(); }
+	return NULL;
+}
+int mesh_export_start(MeshExport* job, Formula* formula, CubeMarchDefintions defs, const char* path, char** err_msg) {
+	if (job->state == EXPORT_RUNNING) { return 0; }
+	if (!formula->func) {
+		cyx_str_append_lit(err_msg, "ERROR:\tOnly implicit functions can be exported!\n");
+		return 0;
+	}
+	if (formula->level_count) {
+		cyx_str_append_lit(err_msg, "ERROR:\tFunctions with levels after '=' can not be exported!\n");
+		return 0;
+	}
+	if (strlen(path) >= sizeof(job->path)) {
+		cyx_str_append_lit(err_msg, "ERROR:\tThe export path is too long!\n");
 		return 0;
 	}
 
+	if (!job->err_msg) {
+		job->err_msg = cyx_str_new(NULL);
+	}
+	cyx_str_clear(job->err_msg);
+	strcpy(job->path, path);
+	job->formula = formula_retain(formula);
+	job->defs = defs;
+	job->generation = atomic_load(&job->latest);
+	atomic_store(&job->layers, 0);
+	atomic_store(&job->finished, 0);
+	job->state = EXPORT_RUNNING;
+	pthread_create(&job->thread, NULL, mesh_export_loop, job);
 	return 1;
 }
+ExportState mesh_export_poll(MeshExport* job) {
+	if (job->state != EXPORT_RUNNING || !atomic_load(&job->finished)) { return job->state; }
+
+	pthread_join(job->thread, NULL);
+	formula_release(job->formula);
+	job->formula = NULL;
+	// a cancelled export fails without a message
+	job->state = job->result ? EXPORT_DONE : cyx_str_length(job->err_msg) ? EXPORT_FAILED : EXPORT_NOTHING;
+	return job->state;
+}
+double mesh_export_progress(MeshExport* job) {
+	return job->state == EXPORT_RUNNING ? (double)atomic_load(&job->layers) / (job->defs.res - 1) : 0;
+}
+void mesh_export_cancel(MeshExport* job) {
+	atomic_fetch_add(&job->latest, 1);
+}
+void mesh_export_stop(MeshExport* job) {
+	if (job->state == EXPORT_RUNNING) {
+		mesh_export_cancel(job);
+		pthread_join(job->thread, NULL);
+		formula_release(job->formula);
+		job->formula = NULL;
+	}
+	if (job->err_msg) {
+		cyx_str_free(job->err_msg);
+	}
+	*job = (MeshExport){ .notify = job->notify };
+}
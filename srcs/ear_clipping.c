@@ -2,7 +2,6 @@
 
 #include <stdio.h>
 #include <math.h>
-#include <glew.h>
 
 #define CYLIBX_ALLOC
 #include <cylibx.h>
@@ -449,104 +448,20 @@ static TriangleVerticesPair turn_contour_into_triangles(EvoAllocator* alloc, Con
 
 	return (TriangleVerticesPair){ .triangles = triangles, .vertices = vertices };
 }
-static void set_projection_matrix(float matrix[], size_t width, size_t height) {
-	memset(matrix, 0, sizeof(*matrix) * 16);
-    matrix[0] = 2.0f / width;
-    matrix[5] = 2.0f / height;
-   	matrix[10] = -1.0f;
-    matrix[12] = -1.0f;
-    matrix[13] = -1.0f;
-    matrix[15] = 1.0f;
-}
-
-Polygon __turn_glyph_into_polygon(struct __PolygonCreateParams params) {
-	GlyphData* glyph = params.__glyph;
-	uint32_t program = params.__program;
-
+void turn_glyph_into_triangles(GlyphData* glyph, float scale, float** vertices, uint32_t** indices) {
 	EvoAllocator temp = evo_allocator_arena_heap(EVO_KB(16));
 
 	Contour* cs = turn_glyph_into_contours(&temp, glyph);
 	TriangleVerticesPair pair = turn_contour_into_triangles(&temp, cs);
-	uint32_t* triangles = pair.triangles;
-	float* vertices = pair.vertices;
-
-	float scale = params.__scale;
 
-	assert(cyx_array_length(vertices) % 3 == 0);
-	for (size_t i = 0; i < cyx_array_length(vertices); i += 3) {
-		vertices[i + 0] *= scale; // x
-		vertices[i + 1] *= -scale; // y
-		vertices[i + 2] = 0.0f; // z
+	assert(cyx_array_length(pair.vertices) % 3 == 0);
+	uint32_t first_vertex = cyx_array_length(*vertices) / 2;
+	for (size_t i = 0; i < cyx_array_length(pair.vertices); i += 3) {
+		cyx_array_append_mult(*vertices, pair.vertices[i] * scale, pair.vertices[i + 1] * -scale);
+	}
+	for (size_t i = 0; i < cyx_array_length(pair.triangles); ++i) {
+		cyx_array_append(*indices, pair.triangles[i] + first_vertex);
 	}
-
-	Polygon poly = {
-		.program = program,
-		.clr = COLOR_WHITE,
-		.indices_count = cyx_array_length(triangles),
-		.pos = vec2i(params.x, params.y),
-	};
-	set_projection_matrix(poly.projection_mat, params.width, params.height);
-	
-	glGenVertexArrays(1, &poly.vao);
-	glBindVertexArray(poly.vao);
-
-	glGenBuffers(1, &poly.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, poly.vbo);
-	glBufferData(GL_ARRAY_BUFFER, cyx_array_length(vertices) * sizeof(float), vertices, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &poly.ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, poly.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, cyx_array_length(triangles) * sizeof(uint32_t), triangles, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), NULL);
-	glEnableVertexAttribArray(0);
 
 	evo_allocator_free(&temp);
-	
-	return poly;
 }
-void poly_show(Polygon* poly, int x, int y, float w, float h, int screen_w, int screen_h) {
-	glDisable(GL_DEPTH_TEST);
-	glUseProgram(poly->program);
-
-	int uniform_color = glGetUniformLocation(poly->program, "color");
-	glUniform4f(uniform_color, poly->clr.r / 255.0, poly->clr.g / 255.0, poly->clr.b / 255.0, 1.0);
-
-	int uniform_model = glGetUniformLocation(poly->program, "u_model");
-	int uniform_projection = glGetUniformLocation(poly->program, "u_proj");
-	float proj[16] = { 
-		[0]  = 2.0f / screen_w, // 2 / (right - left)
-		[5]  = 2.0f / -screen_h, // 2 / (top - bottom)
-		[10] = -1.0f, // -2 / (far - near)
-		[12] = -1.0f, // -(right + left) / (right - left)
-		[13] = 1.0f, // -(top + bottom) / (top - bottom)
-		// [14] = 0.0f, // -(far + near) / (far - near)
-		[15] = 1.0f, // 1
-	};
-	glUniformMatrix4fv(uniform_projection, 1, GL_FALSE, proj);
-
-	float model[16] = {
-		[0]  = w / 2.f,
-		[5]  = h / 2.f,
-		[10] = 1.f,
-		[12] = x + w / 2.f,
-		[13] = y + h / 2.f,
-		[15] = 1.f,
-	};
-	glUniformMatrix4fv(uniform_model, 1, GL_FALSE, model);
-
-	glBindVertexArray(poly->vao);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, poly->ebo);
-	glDrawElements(GL_TRIANGLES, poly->indices_count, GL_UNSIGNED_INT, 0);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-	glUseProgram(0);
-	glEnable(GL_DEPTH_TEST);
-}
-void poly_free(Polygon* poly) {
-	glDeleteVertexArrays(1, &poly->vao);
-	glDeleteBuffers(1, &poly->vbo);
-	glDeleteBuffers(1, &poly->ebo);
-}
-
@@ -2,6 +2,7 @@
 
 #include <string.h>
 #include <assert.h>
+#include <stdlib.h>
 #include <glew.h>
 
 #include <ear_clipping.h>
@@ -13,14 +14,138 @@
 
 #define LETTER_COUNT 128
 
-FontTTF font_compile(uint32_t program, const char* font_file_path, int size, int screen_width, int screen_height) {
+static size_t font_vertex_floats(const FontTTF* font) {
+	return font->backend == FONT_SDF ? 4 : 2;
+}
+static void font_create_buffer(const FontTTF* font, uint32_t* vao, uint32_t* vbo) {
+	size_t stride = font_vertex_floats(font) * sizeof(float);
+	glGenVertexArrays(1, vao);
+	gl_bind_vertex_array(*vao);
+	glGenBuffers(1, vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, NULL);
+	glEnableVertexAttribArray(0);
+	if (font->backend == FONT_SDF) {
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+	}
+	gl_bind_vertex_array(0);
+}
+// atlases of the font files compiled so far, looked up by path
+static FontAtlas** font_atlases = NULL;
+
+// renders all the glyphs into shelves of an atlas FONT_SDF_ATLAS_WIDTH wide
+static FontAtlas* font_build_atlas(TTF* ttf, const char* path) {
+	SdfParams params = {
+		.scale = (float)FONT_SDF_SIZE / ttf->units_per_em,
+		.spread = FONT_SDF_SPREAD,
+	};
+	FontAtlas* atlas = calloc(1, sizeof(FontAtlas));
+	if (!atlas) { return NULL; }
+	snprintf(atlas->path, sizeof(atlas->path), "%s", path);
+
+	int cells[LETTER_COUNT][4] = { 0 };
+	int x = 0, y = 0, shelf = 0;
+	for (size_t i = 0; i < LETTER_COUNT; ++i) {
+		GlyphData* glyph = ttf_get(ttf, i);
+		if (!glyph->found || !cyx_array_length(glyph->contour_end_indicies)) { continue; }
+
+		int w, h;
+		sdf_glyph_size(glyph, params, &w, &h);
+		if (x + w > FONT_SDF_ATLAS_WIDTH) {
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+		cells[i][0] = x;
+		cells[i][1] = y;
+		cells[i][2] = w;
+		cells[i][3] = h;
+		x += w;
+		if (h > shelf) { shelf = h; }
+	}
+	int height = y + shelf;
+
+	uint8_t* pixels = calloc((size_t)FONT_SDF_ATLAS_WIDTH * height, 1);
+	if (!pixels) {
+		free(atlas);
+		return NULL;
+	}
+	for (size_t i = 0; i < LETTER_COUNT; ++i) {
+		if (!cells[i][2]) { continue; }
+		GlyphData* glyph = ttf_get(ttf, i);
+		int* cell = cells[i];
+		sdf_render_glyph(glyph, params, pixels + cell[1] * FONT_SDF_ATLAS_WIDTH + cell[0], FONT_SDF_ATLAS_WIDTH, cell[2], cell[3]);
+
+		float* quad = atlas->quad[i];
+		quad[0] = glyph->min_x * params.scale - params.spread;
+		quad[1] = -glyph->max_y * params.scale - params.spread;
+		quad[2] = quad[0] + cell[2];
+		quad[3] = quad[1] + cell[3];
+		float* uv = atlas->uv[i];
+		uv[0] = (float)cell[0] / FONT_SDF_ATLAS_WIDTH;
+		uv[1] = (float)cell[1] / height;
+		uv[2] = (float)(cell[0] + cell[2]) / FONT_SDF_ATLAS_WIDTH;
+		uv[3] = (float)(cell[1] + cell[3]) / height;
+	}
+
+	glGenTextures(1, &atlas->texture);
+	gl_bind_texture(GL_TEXTURE_2D, atlas->texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_SDF_ATLAS_WIDTH, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	free(pixels);
+	return atlas;
+}
+// the atlas of the file at `path`, built the first time any size of it is compiled
+static FontAtlas* font_atlas_retain(TTF* ttf, const char* path) {
+	if (!font_atlases) {
+		font_atlases = cyx_array_new(FontAtlas*, NULL);
+	}
+	for (size_t i = 0; i < cyx_array_length(font_atlases); ++i) {
+		if (!strcmp(font_atlases[i]->path, path)) {
+			++font_atlases[i]->refs;
+			return font_atlases[i];
+		}
+	}
+	FontAtlas* atlas = font_build_atlas(ttf, path);
+	if (!atlas) { return NULL; }
+	atlas->refs = 1;
+	cyx_array_append(font_atlases, atlas);
+	return atlas;
+}
+static void font_atlas_release(FontAtlas* atlas) {
+	if (--atlas->refs) { return; }
+	for (size_t i = 0; i < cyx_array_length(font_atlases); ++i) {
+		if (font_atlases[i] == atlas) {
+			cyx_array_remove(font_atlases, i);
+			break;
+		}
+	}
+	glDeleteTextures(1, &atlas->texture);
+	free(atlas);
+	if (!cyx_array_length(font_atlases)) {
+		cyx_array_free(font_atlases);
+		font_atlases = NULL;
+	}
+}
+FontTTF font_compile(const Program* program, FontBackend backend, const char* font_file_path, int size, int screen_width, int screen_height) {
 	assert(size > 0);
 
 	FontTTF font = {
 		.size = size,
 		.program = program,
+		.backend = backend,
 		.ttf = ttf_parse(font_file_path),
 		.screen_wh = vec2i(screen_width, screen_height),
+		.glyph_vertices = cyx_array_new(float, NULL),
+		.glyph_indices = cyx_array_new(uint32_t, NULL),
+		.batch = cyx_array_new(float, NULL),
 	};
 	font.scale = (float)size / font.ttf.units_per_em;
 
@@ -30,15 +155,34 @@ FontTTF font_compile(uint32_t program, const char* font_file_path, int size, int
 
 		Letter* curr = font.letters + i;
 		// if (i > 32) printf("%d: '%c'\n", (int)i, (char)i);
-		curr->poly = turn_glyph_into_polygon(glyph, font.program, font.scale,
-					.height = screen_height, .width = screen_width);
+		if (backend == FONT_MESH) {
+			curr->first_index = cyx_array_length(font.glyph_indices);
+			turn_glyph_into_triangles(glyph, font.scale, &font.glyph_vertices, &font.glyph_indices);
+			curr->index_count = cyx_array_length(font.glyph_indices) - curr->first_index;
+		}
 		curr->found = 1;
 		curr->advance = glyph->advance_width * font.scale;
 	}
+	if (backend == FONT_SDF) {
+		font.atlas = font_atlas_retain(&font.ttf, font_file_path);
+		if (!font.atlas) {
+			fprintf(stderr, "ERROR:\tUnable to build the distance field atlas of [\"%s\"]!\n", font_file_path);
+		} else {
+			// from atlas pixels to pixels at the size of the font
+			float to_screen = font.scale / ((float)FONT_SDF_SIZE / font.ttf.units_per_em);
+			for (size_t i = 0; i < LETTER_COUNT; ++i) {
+				for (size_t j = 0; j < 4; ++j) {
+					font.letters[i].quad[j] = font.atlas->quad[i][j] * to_screen;
+					font.letters[i].uv[j] = font.atlas->uv[i][j];
+				}
+			}
+		}
+	}
 
+	font_create_buffer(&font, &font.vao, &font.vbo);
 	return font;
 }
-int font_show(FontTTF* font, char c, int x, int y, int screen_w, int screen_h) {
+int font_queue(FontTTF* font, char c, int x, int y) {
 	Letter* letter = &font->letters[(int)c];
 	if (!letter->found) {
 		return 0;
@@ -46,9 +190,94 @@ int font_show(FontTTF* font, char c, int x, int y, int screen_w, int screen_h) {
 		return letter->advance;
 	}
 
-	poly_show(&letter->poly, x, y + font->size, 2.0f, 2.0f, screen_w, screen_h);
+	// the baseline sits a font size below the pen
+	float dx = x + 1.f;
+	float dy = y + font->size + 1.f;
+	if (font->backend == FONT_SDF) {
+		const float* q = letter->quad;
+		const float* uv = letter->uv;
+		if (q[2] <= q[0]) { return letter->advance; }
+		cyx_array_append_mult(font->batch,
+			q[0] + dx, q[1] + dy, uv[0], uv[1],
+			q[0] + dx, q[3] + dy, uv[0], uv[3],
+			q[2] + dx, q[3] + dy, uv[2], uv[3],
+			q[0] + dx, q[1] + dy, uv[0], uv[1],
+			q[2] + dx, q[3] + dy, uv[2], uv[3],
+			q[2] + dx, q[1] + dy, uv[2], uv[1],
+		);
+		return letter->advance;
+	}
+	for (uint32_t i = letter->first_index; i < letter->first_index + letter->index_count; ++i) {
+		const float* v = font->glyph_vertices + 2 * font->glyph_indices[i];
+		cyx_array_append_mult(font->batch, v[0] + dx, v[1] + dy);
+	}
 	return letter->advance;
 }
+static void font_draw(FontTTF* font, uint32_t vao, uint32_t vertex_count, Color color, int screen_w, int screen_h) {
+	gl_set_cap(GL_STATE_DEPTH_TEST, 0);
+	gl_set_cap(GL_STATE_CULL_FACE, 0);
+	gl_viewport(0, 0, screen_w, screen_h);
+	gl_use_program(font->program->id);
+
+	const int32_t* uniforms = font->program->uniforms;
+	glUniform4f(uniforms[UNIFORM_COLOR], COLOR_UNPACK_F(color));
+	float proj[16] = { 
+		[0]  = 2.0f / screen_w, // 2 / (right - left)
+		[5]  = 2.0f / -screen_h, // 2 / (top - bottom)
+		[10] = -1.0f, // -2 / (far - near)
+		[12] = -1.0f, // -(right + left) / (right - left)
+		[13] = 1.0f, // -(top + bottom) / (top - bottom)
+		[15] = 1.0f, // 1
+	};
+	glUniformMatrix4fv(uniforms[UNIFORM_PROJ], 1, GL_FALSE, proj);
+	if (font->backend == FONT_SDF) {
+		glActiveTexture(GL_TEXTURE0);
+		gl_bind_texture(GL_TEXTURE_2D, font->atlas ? font->atlas->texture : 0);
+		glUniform1i(uniforms[UNIFORM_TEXTURE], 0);
+	}
+
+	gl_bind_vertex_array(vao);
+	gl_draw_arrays(GL_TRIANGLES, 0, vertex_count);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+}
+void font_flush(FontTTF* font, Color color, int screen_w, int screen_h) {
+	size_t size = cyx_array_length(font->batch) * sizeof(float);
+	if (!size) { return; }
+
+	// the old storage gets orphaned so the driver never waits on a draw still reading it
+	glBindBuffer(GL_ARRAY_BUFFER, font->vbo);
+	if (size > font->vbo_capacity) {
+		font->vbo_capacity = size * 2;
+	}
+	glBufferData(GL_ARRAY_BUFFER, font->vbo_capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, font->batch);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	font_draw(font, font->vao, cyx_array_length(font->batch) / font_vertex_floats(font), color, screen_w, screen_h);
+	cyx_array_clear(font->batch);
+}
+void font_bake(FontTTF* font, TextMesh* mesh) {
+	if (!mesh->vao) {
+		font_create_buffer(font, &mesh->vao, &mesh->vbo);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+	glBufferData(GL_ARRAY_BUFFER, cyx_array_length(font->batch) * sizeof(float), font->batch, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mesh->vertex_count = cyx_array_length(font->batch) / font_vertex_floats(font);
+	mesh->dirty = 0;
+	cyx_array_clear(font->batch);
+}
+void font_show_mesh(FontTTF* font, TextMesh* mesh, Color color, int screen_w, int screen_h) {
+	if (!mesh->vertex_count) { return; }
+	font_draw(font, mesh->vao, mesh->vertex_count, color, screen_w, screen_h);
+}
+void text_mesh_free(TextMesh* mesh) {
+	if (!mesh->vao) { return; }
+	gl_delete_vertex_arrays(1, &mesh->vao);
+	glDeleteBuffers(1, &mesh->vbo);
+	*mesh = (TextMesh){ 0 };
+}
 int font_get_advance(FontTTF* font, char c) {
 	Letter* letter = &font->letters[(int)c];
 	if (!letter->found) {
@@ -64,12 +293,14 @@ int font_get_text_width(FontTTF* font, size_t n, const char* str) {
 	return sum;
 }
 void font_free(FontTTF* font) {
-	for (size_t i = 0; i < LETTER_COUNT; ++i) {
-		Letter* curr = font->letters + i;
-		if (!curr->found) { continue; }
-		poly_free(&curr->poly);
+	gl_delete_vertex_arrays(1, &font->vao);
+	glDeleteBuffers(1, &font->vbo);
+	if (font->atlas) {
+		font_atlas_release(font->atlas);
 	}
-	glDeleteProgram(font->program);
+	cyx_array_free(font->glyph_vertices);
+	cyx_array_free(font->glyph_indices);
+	cyx_array_free(font->batch);
 	ttf_free(&font->ttf);
 }
 
@@ -0,0 +1,128 @@
+#include <gl_state.h>
+
+#include <string.h>
+
+static const GLenum caps[GL_STATE_CAP_COUNT] = {
+	[GL_STATE_DEPTH_TEST] = GL_DEPTH_TEST,
+	[GL_STATE_CULL_FACE] = GL_CULL_FACE,
+	[GL_STATE_BLEND] = GL_BLEND,
+};
+
+// -1 stands for not known, GL names are never that large
+static struct {
+	int64_t program;
+	int64_t vao;
+	int8_t caps[GL_STATE_CAP_COUNT];
+	int viewport[4];
+	int64_t blend_src, blend_dst;
+
+	size_t issued;
+	size_t elided;
+	size_t core;
+} state = {
+	.program = -1,
+	.vao = -1,
+	.caps = { -1, -1, -1 },
+	.viewport = { -1, -1, -1, -1 },
+	.blend_src = -1,
+	.blend_dst = -1,
+};
+
+void gl_state_reset(void) {
+	state.program = -1;
+	state.vao = -1;
+	memset(state.caps, -1, sizeof(state.caps));
+	state.viewport[0] = state.viewport[1] = state.viewport[2] = state.viewport[3] = -1;
+	state.blend_src = state.blend_dst = -1;
+}
+
+void gl_use_program(uint32_t program) {
+	if (state.program == program) { ++state.elided; return; }
+	state.program = program;
+	++state.issued;
+	glUseProgram(program);
+}
+void gl_bind_vertex_array(uint32_t vao) {
+	if (state.vao == vao) { ++state.elided; return; }
+	state.vao = vao;
+	++state.issued;
+	glBindVertexArray(vao);
+}
+void gl_set_cap(GlStateCap cap, int enabled) {
+	enabled = !!enabled;
+	if (state.caps[cap] == enabled) { ++state.elided; return; }
+	state.caps[cap] = enabled;
+	++state.issued;
+	if (enabled) {
+		++state.core;
+		glEnable(caps[cap]);
+	} else {
+		++state.core;
+		glDisable(caps[cap]);
+	}
+}
+void gl_viewport(int x, int y, int w, int h) {
+	int* v = state.viewport;
+	if (v[0] == x && v[1] == y && v[2] == w && v[3] == h) { ++state.elided; return; }
+	v[0] = x;
+	v[1] = y;
+	v[2] = w;
+	v[3] = h;
+	++state.issued;
+	++state.core;
+	glViewport(x, y, w, h);
+}
+void gl_blend_func(GLenum src, GLenum dst) {
+	if (state.blend_src == src && state.blend_dst == dst) { ++state.elided; return; }
+	state.blend_src = src;
+	state.blend_dst = dst;
+	++state.issued;
+	++state.core;
+	glBlendFunc(src, dst);
+}
+
+void gl_clear_color(float r, float g, float b, float a) {
+	++state.core;
+	glClearColor(r, g, b, a);
+}
+void gl_clear(GLbitfield mask) {
+	++state.core;
+	glClear(mask);
+}
+void gl_flush(void) {
+	++state.core;
+	glFlush();
+}
+void gl_bind_texture(GLenum target, uint32_t texture) {
+	++state.core;
+	glBindTexture(target, texture);
+}
+void gl_draw_elements(GLenum mode, int count, GLenum type, const void* indices) {
+	++state.core;
+	glDrawElements(mode, count, type, indices);
+}
+void gl_draw_arrays(GLenum mode, int first, int count) {
+	++state.core;
+	glDrawArrays(mode, first, count);
+}
+
+void gl_delete_program(uint32_t program) {
+	if (state.program == program) { state.program = 0; }
+	glDeleteProgram(program);
+}
+void gl_delete_vertex_arrays(int count, const uint32_t* vaos) {
+	for (int i = 0; i < count; ++i) {
+		if (state.vao == vaos[i]) { state.vao = 0; }
+	}
+	glDeleteVertexArrays(count, vaos);
+}
+
+size_t gl_state_issued(void) {
+	return state.issued;
+}
+size_t gl_state_elided(void) {
+	return state.elided;
+}
+size_t gl_state_core_calls(void) {
+	return state.core;
+}
@@ -8,11 +8,14 @@
 
 #include <immediate.h>
 #include <stdio.h>
+#include <errno.h>
 
 static const char* programs[2 * PROGRAM_COUNT] = {
 	"./resources/shaders/font.vert", "./resources/shaders/font.frag",
-	"./resources/shaders/basic.vert", "./resources/shaders/basic.frag",
 	"./resources/shaders/shader3d.vert", "./resources/shaders/shader3d.frag",
+	"./resources/shaders/image.vert", "./resources/shaders/image.frag",
+	"./resources/shaders/font_sdf.vert", "./resources/shaders/font_sdf.frag",
+	"./resources/shaders/rect_batch.vert", "./resources/shaders/rect_batch.frag",
 };
 
 static ScenePair context_get(Context* ctx, char* id) {
@@ -214,12 +217,11 @@ void __grid_add(struct __GridAddParams params) {
 		showable->id = cyx_str_copy_a(&ctx->perm, id);
 		switch (type) {
 			case SHOWABLE_RECT: {
-				showable->as.rect = rect_create(
-					ctx->programs[PROGRAM_RECT],
-					params.color,
+				showable->as.rect = (Rectangle){
+					.color = params.color,
 					.border_color = params.border_color,
-					.border_width = params.border_width
-				);
+					.border_width = params.border_width,
+				};
 			} break;
 			case SHOWABLE_STATIC_TEXT: {
 				const char* str = params.__str;
@@ -229,6 +231,7 @@ void __grid_add(struct __GridAddParams params) {
 				}
 				showable->as.static_text.text = cyx_str_from_lit(&ctx->perm, str);
 				showable->as.static_text.clr = color;
+				showable->as.static_text.mesh = (TextMesh){ .dirty = 1 };
 
 				showable->as.static_text.center_x = params.center ? 1 : params.center_x;
 				showable->as.static_text.center_y = params.center ? 1 : params.center_y;
@@ -241,7 +244,7 @@ void __grid_add(struct __GridAddParams params) {
 				}
 				showable->as.dyn_text.is_selected = 0;
 				showable->as.dyn_text.clr = color;
-				showable->as.dyn_text.cursor = rect_create(ctx->programs[PROGRAM_RECT], color);
+				showable->as.dyn_text.cursor = (Rectangle){ .color = color };
 
 				showable->as.dyn_text.center_x = params.center ? 1 : params.center_x;
 				showable->as.dyn_text.center_y = params.center ? 1 : params.center_y;
@@ -251,7 +254,7 @@ void __grid_add(struct __GridAddParams params) {
 			} break;
 			case SHOWABLE_3D: {
 				assert(params.indices && params.vertices);
-				showable->as.shape = shape3d_create(ctx->programs[PROGRAM_3D], color, params.scale, params.indices, params.vertices);
+				showable->as.shape = shape3d_create(&ctx->programs[PROGRAM_3D], &ctx->camera_block, color, params.scale, params.indices, params.vertices);
 				showable->as.shape.camera = params.camera;
 				showable->as.shape.light_color = params.light_color;
 				showable->as.shape.light_pos = params.light_pos;
@@ -259,6 +262,9 @@ void __grid_add(struct __GridAddParams params) {
 				showable->as.shape.depth_test = params.depth_test;
 				showable->as.shape.face_cull = params.cull_faces;
 			} break;
+			case SHOWABLE_IMAGE: {
+				showable->as.image = image_create(&ctx->programs[PROGRAM_IMAGE]);
+			} break;
 			default: assert(0 && "UNREACHABLE");
 		}
 		ret.ptr = showable;
@@ -281,11 +287,18 @@ void __grid_add(struct __GridAddParams params) {
 				}
 				if (!cyx_str_eq(cyx_str_from_lit(&ctx->temp, str), showable->as.static_text.text)) {
 					showable->as.static_text.text = cyx_str_from_lit(&ctx->perm, str);
+					showable->as.static_text.mesh.dirty = 1;
 				}
 				showable->as.static_text.clr = color;
 
-				showable->as.static_text.center_x = params.center ? 1 : params.center_x;
-				showable->as.static_text.center_y = params.center ? 1 : params.center_y;
+				// the centring is baked into the mesh, the colour only goes to the shader
+				uint8_t center_x = params.center ? 1 : params.center_x;
+				uint8_t center_y = params.center ? 1 : params.center_y;
+				if (center_x != showable->as.static_text.center_x || center_y != showable->as.static_text.center_y) {
+					showable->as.static_text.mesh.dirty = 1;
+				}
+				showable->as.static_text.center_x = center_x;
+				showable->as.static_text.center_y = center_y;
 			} break;
 			case SHOWABLE_TEXT_INPUT: {
 				showable->as.dyn_text.clr = color;
@@ -309,6 +322,7 @@ void __grid_add(struct __GridAddParams params) {
 				showable->as.shape.depth_test = params.depth_test;
 				showable->as.shape.face_cull = params.cull_faces;
 			} break;
+			case SHOWABLE_IMAGE: break;
 			default: assert(0 && "UNREACHABLE");
 		}
 	}
@@ -369,6 +383,7 @@ static int scene_data_get_clicked(Context* ctx, SceneShowable* data, Vec2i other
 			}
 			break;
 		case SHOWABLE_3D: break;
+		case SHOWABLE_IMAGE: break;
 		default: assert(0 && "UNREACHABLE");
 	}
 	return 0;
@@ -380,8 +395,23 @@ static void scene_data_show(Context* ctx, char* id, int x, int y, int w, int h)
 	if (ret.type == DATA_ERROR || ret.type > DATA_SEPARATOR) { return; }
 
 	SceneShowable* showable = ret.ptr;
+	// runs of rectangles in the z order get drawn together, anything else has to go over the ones before it
+	if (showable->type != SHOWABLE_RECT) {
+		rect_batch_flush(&ctx->rect_batch, ctx->wh.x, ctx->wh.y);
+	}
 	switch (showable->type) {
 		case SHOWABLE_STATIC_TEXT: {
+			TextMesh* mesh = &showable->as.static_text.mesh;
+			if (!mesh->dirty && mesh->x == x && mesh->y == y && mesh->w == w && mesh->h == h && vec2i_eq(mesh->screen_wh, ctx->wh)) {
+				font_show_mesh(font, mesh, showable->as.static_text.clr, ctx->wh.x, ctx->wh.y);
+				break;
+			}
+			mesh->x = x;
+			mesh->y = y;
+			mesh->w = w;
+			mesh->h = h;
+			mesh->screen_wh = ctx->wh;
+
 			char* str = showable->as.static_text.text;
 			if (showable->as.static_text.center_x) {
 				int font_w = font_get_text_width(font, cyx_str_length(str), str);
@@ -394,13 +424,15 @@ static void scene_data_show(Context* ctx, char* id, int x, int y, int w, int h)
 			int xx = x;
 			for (size_t i = 0; i < cyx_str_length(str); ++i) {
 				if (str[i] != '\n') {
-					int advance = font_show(font, str[i], x, y, ctx->wh.x, ctx->wh.y);
+					int advance = font_queue(font, str[i], x, y);
 					x += advance;
 				} else {
 					x = xx;
 					y += 1.2 * font->size;
 				}
 			}
+			font_bake(font, mesh);
+			font_show_mesh(font, mesh, showable->as.static_text.clr, ctx->wh.x, ctx->wh.y);
 	   	} break;
 		case SHOWABLE_TEXT_INPUT: {
 			char* str = showable->as.dyn_text.text;
@@ -412,7 +444,7 @@ static void scene_data_show(Context* ctx, char* id, int x, int y, int w, int h)
 			if (showable->as.dyn_text.text_wrap) {
 				for (size_t i = 0; i < cyx_str_length(str); ++i) {
 					if (str[i] != '\n') {
-						int advance = font_show(font, str[i], x, y, ctx->wh.x, ctx->wh.y);
+						int advance = font_queue(font, str[i], x, y);
 						x += advance;
 						if (x + advance >= xx + w) {
 							x = xx;
@@ -425,14 +457,15 @@ static void scene_data_show(Context* ctx, char* id, int x, int y, int w, int h)
 				}
 			} else {
 				for (size_t i = 0; i < cyx_str_length(str); ++i) {
-					int advance = font_show(font, str[i], x, y, ctx->wh.x, ctx->wh.y);
+					int advance = font_queue(font, str[i], x, y);
 					x += advance;
 				}
 			}
+			font_flush(font, showable->as.dyn_text.clr, ctx->wh.x, ctx->wh.y);
 			if (showable->as.dyn_text.is_selected) {
 				if (showable->as.dyn_text.cursor_pos == -1) {
 					int cursor_w = font_get_advance(font, ' ');
-					rect_show(&showable->as.dyn_text.cursor, x, y, cursor_w, 1.2f * font->size, ctx->wh.x, ctx->wh.y);
+					rect_batch_push(&ctx->rect_batch, &showable->as.dyn_text.cursor, x, y, cursor_w, 1.2f * font->size);
 				} else {
 					x = xx;
 					y = yy;
@@ -450,68 +483,108 @@ static void scene_data_show(Context* ctx, char* id, int x, int y, int w, int h)
 						}
 					}
 					int cursor_w = font_get_advance(font, ' ');
-					rect_show(&showable->as.dyn_text.cursor, x, y, cursor_w, 1.2f * font->size, ctx->wh.x, ctx->wh.y);
+					rect_batch_push(&ctx->rect_batch, &showable->as.dyn_text.cursor, x, y, cursor_w, 1.2f * font->size);
 				}
 			}
 		} break;
 		case SHOWABLE_RECT:
-			rect_show(&showable->as.rect, x, y, w, h, ctx->wh.x, ctx->wh.y);
+			rect_batch_push(&ctx->rect_batch, &showable->as.rect, x, y, w, h);
 			break;
 		case SHOWABLE_3D:
-			shape3d_show(&showable->as.shape, x, y, w, h, ctx->wh.x, ctx->wh.y);
+			shape3d_show(&showable->as.shape, x, y, w, h);
+			break;
+		case SHOWABLE_IMAGE:
+			image_show(&showable->as.image, x, y, w, h);
 			break;
 		default: assert(0 && "UNREACHABLE");
 	}
 }
 
+static int64_t timespec_ns(struct timespec t) {
+	return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+static struct timespec timespec_from_ns(int64_t ns) {
+	return (struct timespec){ .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+}
+// waits for the deadline of this frame, a frame that already missed it starts the count over instead of rushing to catch up
+static void timer_pace(Timer* timer) {
+	const int64_t period = 1000000000 / TIMER_FPS_CAP;
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	int64_t now = timespec_ns(t);
+	int64_t deadline = timespec_ns(timer->deadline) + period;
+	if (deadline <= now) {
+		timer->deadline = t;
+		return;
+	}
+
+	if (deadline - now > TIMER_SPIN_NS) {
+		struct timespec wake = timespec_from_ns(deadline - TIMER_SPIN_NS);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+	}
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &t);
+	} while (timespec_ns(t) < deadline);
+	timer->deadline = timespec_from_ns(deadline);
+}
+static int float_cmp(const void* a, const void* b) {
+	float x = *(const float*)a, y = *(const float*)b;
+	return (x > y) - (x < y);
+}
+FrameStats timer_frame_stats(const Timer* timer) {
+	FrameStats stats = { .count = timer->frame_count };
+	if (!stats.count) { return stats; }
+
+	float sorted[TIMER_HISTORY];
+	memcpy(sorted, timer->frame_ms, stats.count * sizeof(float));
+	qsort(sorted, stats.count, sizeof(float), float_cmp);
+	stats.p50 = sorted[(stats.count - 1) * 50 / 100];
+	stats.p95 = sorted[(stats.count - 1) * 95 / 100];
+	stats.p99 = sorted[(stats.count - 1) * 99 / 100];
+	stats.max = sorted[stats.count - 1];
+	return stats;
+}
 void updateTimer(Timer* timer) {
+	if (timer->fps_cap) {
+		timer_pace(timer);
+	}
+
 	struct timespec t;
 	clock_gettime(CLOCK_MONOTONIC, &t);
 	double curr_time = t.tv_sec + t.tv_nsec * 1e-9;
+	if (!timer->start_time) {
+		timer->start_time = curr_time;
+		timer->prev_time = curr_time;
+	}
+	timer->elapsed = curr_time - timer->start_time;
 	timer->dt = curr_time - timer->prev_time;
 	timer->prev_time = curr_time;
 	timer->collection += timer->dt;
 
-	timer->frames++;
-	if (timer->fps_cap && timer->frames >= 75) {
-		usleep((1. - timer->collection) * 1e6);
-		timer->collection = 1.1;
+	timer->frame_ms[timer->frame_next] = timer->dt * 1000;
+	timer->frame_next = (timer->frame_next + 1) % TIMER_HISTORY;
+	if (timer->frame_count < TIMER_HISTORY) {
+		++timer->frame_count;
 	}
+
+	timer->frames++;
 	if (timer->collection > 1.) {
 		if (timer->log) {
-			printf("FPS:\t%zu\n", timer->frames);
+			FrameStats stats = timer_frame_stats(timer);
+			printf("FPS:\t%zu, frame times p50 %.2fms, p95 %.2fms, p99 %.2fms, max %.2fms\n",
+				timer->frames, stats.p50, stats.p95, stats.p99, stats.max);
+			printf("LOG:\tGL calls per frame %zu\n", (gl_call_count() - timer->gl_calls) / timer->frames);
+			printf("LOG:\tGL state changes per frame %zu issued, %zu skipped\n",
+				(gl_state_issued() - timer->gl_state_issued) / timer->frames,
+				(gl_state_elided() - timer->gl_state_elided) / timer->frames);
+			timer->gl_calls = gl_call_count();
+			timer->gl_state_issued = gl_state_issued();
+			timer->gl_state_elided = gl_state_elided();
 		}
 		timer->frames = 0;
 		timer->collection = 0.0;
 	}
 }
-uint32_t compile_program(EvoAllocator* alloc, const char* vert_file, const char* frag_file) {
-	evo_temp_set_mark(alloc->ctx);
-	char* source = cyx_str_from_file(alloc, vert_file);
-	uint32_t vert_shader = glCreateShader(GL_VERTEX_SHADER);
-	int32_t len = cyx_str_length(source);
-	glShaderSource(vert_shader, 1, (const char* const*)&source, &len);
-	glCompileShader(vert_shader);
-	check_shader_compile_status(vert_shader, vert_file);
-
-	source = cyx_str_from_file(alloc, frag_file);
-	uint32_t frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	len = cyx_str_length(source);
-	glShaderSource(frag_shader, 1, (const char* const*)&source, &len);
-	glCompileShader(frag_shader);
-	check_shader_compile_status(frag_shader, frag_file);
-
-	uint32_t program = glCreateProgram();
-	glAttachShader(program, vert_shader);
-	glAttachShader(program, frag_shader);
-	glLinkProgram(program);
-	check_program_compile_status(program);
-
-	glDeleteShader(vert_shader);
-	glDeleteShader(frag_shader);
-	evo_temp_reset_mark(alloc->ctx);
-	return program;
-}
 static int name_size_eq(const void* const a, const void* const b) {
 	const NameSizePair* const p1 = a;
 	const NameSizePair* const p2 = b;
@@ -525,9 +598,18 @@ static size_t name_size_hash(const void* const val) {
 static void context_compile_programs(Context* ctx) {
 	EvoTempStack temp = { 0 };
 	EvoAllocator alloc = evo_allocator_temp(&temp);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	size_t cached = 0;
 	for (size_t i = 0; i < PROGRAM_COUNT; ++i) {
-		ctx->programs[i] = compile_program(&alloc, programs[2 * i], programs[2 * i + 1]);
+		ctx->programs[i] = compile_program(&alloc, programs[2 * i], programs[2 * i + 1], ctx->program_cache_off ? NULL : PROGRAM_CACHE_DIR);
+		cached += ctx->programs[i].from_cache;
 	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+	printf("LOG:\tPrograms ready in %.1fms, %zu of %d from the binary cache\n", ms, cached, PROGRAM_COUNT);
 }
 static void context_add_font(Context* ctx, const char* font_name, size_t size) {
 	char* file_path = cyx_str_copy(ctx->font_dir);
@@ -542,7 +624,8 @@ static void context_add_font(Context* ctx, const char* font_name, size_t size) {
 			.name = file_name,
 			.size = size
 		}),
-		font_compile(ctx->programs[PROGRAM_FONT],
+		font_compile(&ctx->programs[ctx->font_backend == FONT_SDF ? PROGRAM_FONT_SDF : PROGRAM_FONT],
+			ctx->font_backend,
 			file_path,
 			size,
 			ctx->wh.x,
@@ -587,6 +670,7 @@ static void context_events(Context* ctx) {
 	updateTimer(&ctx->timer);
 	RGFW_event event;
 	while (RGFW_window_checkEvent(ctx->win, &event)) {
+		context_redraw(ctx);
 		if (event.type == RGFW_quit) {
 			break;
 		} else if (event.type == RGFW_mouseButtonPressed) {
@@ -669,11 +753,12 @@ static void context_events(Context* ctx) {
 			}
 		} else if (event.type == RGFW_windowResized) {
 			RGFW_window_getSize(ctx->win, &ctx->wh.x, &ctx->wh.y);
-			glViewport(0, 0, ctx->wh.x, ctx->wh.y);
+			gl_viewport(0, 0, ctx->wh.x, ctx->wh.y);
 		}
 	}
 
 	cyx_ring_drain(val, ctx->event_queue) {
+		context_redraw(ctx);
 		switch (val->type) {
 			case EVENT_SHOWABLE_CLICKED:
 				if (ctx->showable_clicked && ctx->showable_clicked->type == SHOWABLE_TEXT_INPUT) {
@@ -709,8 +794,8 @@ static void context_events(Context* ctx) {
 	}
 }
 static void context_show(Context* ctx) {
-	glClearColor(0x18/255.0f, 0x18/255.0f, 0x18/255.0f, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT);
+	gl_clear_color(0x18/255.0f, 0x18/255.0f, 0x18/255.0f, 1.0);
+	gl_clear(GL_COLOR_BUFFER_BIT);
 
 	grid_init(ctx);
 	if (ctx->scenes && ctx->curr_scene) {
@@ -727,6 +812,7 @@ static void context_show(Context* ctx) {
 				ZBuffer buf = ctx->z_buffer[i];
 				scene_data_show(ctx, buf.id, buf.x, buf.y, buf.w, buf.h);
 			}
+			rect_batch_flush(&ctx->rect_batch, ctx->wh.x, ctx->wh.y);
 
 			if (ctx->mouse_info.pressed) {
 				cyx_array_reverse(ctx->z_buffer);
@@ -765,6 +851,8 @@ void context_setup(Context* ctx, size_t scene_count, SceneDescription* scenes) {
 	ctx->win = RGFW_createWindow("Grphing Calculator", 0, 0, WIDTH, HEIGHT, RGFW_windowCenter | RGFW_windowOpenGL);
 	ctx->fullscreen = 0;
 	RGFW_window_swapInterval_OpenGL(ctx->win, 0);
+	// RGFW only opens the pipe context_wake writes into on the first wait, the jobs can finish before that
+	RGFW_waitForEvent(1);
 
 	GLenum err = glewInit();
 	if (err != GLEW_OK) {
@@ -772,13 +860,19 @@ void context_setup(Context* ctx, size_t scene_count, SceneDescription* scenes) {
 		exit(1);
 	}
 	printf("LOG:\tOpenGL version supported: %s\n", glGetString(GL_VERSION));
+	if (ctx->timer.log) {
+		gl_count_calls();
+	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glViewport(0, 0, WIDTH, HEIGHT);
+	gl_state_reset();
+	gl_set_cap(GL_STATE_BLEND, 1);
+	gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_viewport(0, 0, WIDTH, HEIGHT);
 
 // opengl programs
 	context_compile_programs(ctx);
+	ctx->rect_batch = rect_batch_create(&ctx->programs[PROGRAM_RECT_BATCH]);
+	ctx->camera_block = camera_block_create();
 
 // arena for stuff that needs to be saved over the lifetime of the app
 	ctx->perm_arena = evo_arena_new(EVO_KB(64));
@@ -821,31 +915,107 @@ void context_setup(Context* ctx, size_t scene_count, SceneDescription* scenes) {
 			.setup = scenes[i].setup,
 			.show = scenes[i].show,
 			.key_callback = scenes[i].key_callback,
+			.cleanup = scenes[i].cleanup,
 		}));
 	}
 }
+void context_redraw(Context* ctx) {
+	ctx->redraw_frames = CONTEXT_REDRAW_FRAMES;
+}
+void context_wake_in(Context* ctx, int ms) {
+	if (ms < 0) { ms = 0; }
+	if (ctx->wake_ms < 0 || ms < ctx->wake_ms) {
+		ctx->wake_ms = ms;
+	}
+}
+void context_wake(void) {
+	RGFW_stopCheckEvents();
+}
+// FNV-1a over the values, the scene can change them from anywhere in its show function
+static uint64_t context_values_hash(Context* ctx) {
+	uint64_t hash = 0xcbf29ce484222325;
+	if (!ctx->values) { return hash; }
+	cyx_hashmap_foreach(kv, ctx->values) {
+		const uint8_t* bytes = (const uint8_t*)kv->value;
+		for (size_t i = 0; i < sizeof(SceneValue); ++i) {
+			hash = (hash ^ bytes[i]) * 0x100000001b3;
+		}
+	}
+	return hash;
+}
+static double context_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+// blocks on the window events, returns 0 if it only woke up because nothing happened for CONTEXT_IDLE_WAIT_MS
+static int context_wait(Context* ctx) {
+	int timeout = ctx->wake_ms >= 0 ? ctx->wake_ms : CONTEXT_IDLE_WAIT_MS;
+	double start = context_now();
+	RGFW_waitForEvent(timeout);
+	double waited = context_now() - start;
+	// the time spent asleep is no part of the next frame's dt
+	ctx->timer.prev_time += waited;
+	return ctx->wake_ms >= 0 || waited * 1000 < timeout;
+}
 void context_update(Context* ctx) {
+	context_redraw(ctx);
+	ctx->wake_ms = -1;
 	while (!RGFW_window_shouldClose(ctx->win)) {
+		if (ctx->redraw_frames) {
+			--ctx->redraw_frames;
+		} else if (!context_wait(ctx)) {
+			continue;
+		}
+		ctx->wake_ms = -1;
+
 		evo_alloc_reset(&ctx->temp);
 		ctx->grids = cyx_array_new(Grid, &ctx->temp);
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gl_clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		context_show(ctx);
 		context_events(ctx);
 
+		uint64_t values_hash = context_values_hash(ctx);
+		if (values_hash != ctx->values_hash) {
+			ctx->values_hash = values_hash;
+			context_redraw(ctx);
+		}
+		if (ctx->capture.active) {
+			capture_frame(&ctx->capture, ctx->wh.x, ctx->wh.y);
+			context_redraw(ctx);
+		}
+
 		RGFW_window_swapBuffers_OpenGL(ctx->win);
-		glFlush();
+		gl_flush();
 		// printf("Perm filled: %zu\tTemp filled: %zu\n", evo_arena_size(&ctx->perm_arena), evo_arena_size(&ctx->temp_arena));
 	}
 }
+void context_toggle_capture(Context* ctx, const char* dir) {
+	if (ctx->capture.active) {
+		capture_stop(&ctx->capture);
+	} else if (capture_start(&ctx->capture, dir)) {
+		context_redraw(ctx);
+	}
+}
 void context_cleanup(Context* ctx) {
+	if (ctx->scenes) {
+		cyx_hashmap_foreach(kv, ctx->scenes) {
+			if (kv->value.setup_done && kv->value.cleanup) {
+				kv->value.cleanup(ctx);
+			}
+		}
+	}
+	capture_stop(&ctx->capture);
 	evo_alloc_destroy(&ctx->perm);
 	evo_alloc_destroy(&ctx->temp);
 	evo_alloc_destroy(&ctx->scene_alloc);
 
 	for (size_t i = 0; i < PROGRAM_COUNT; ++i) {
-		glDeleteProgram(ctx->programs[i]);
+		program_free(&ctx->programs[i]);
 	}
+	rect_batch_free(&ctx->rect_batch);
+	camera_block_free(&ctx->camera_block);
 	RGFW_window_close(ctx->win);
 }
 
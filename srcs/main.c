@@ -2,6 +2,13 @@
 #include <cube_marching.h>
 #include <mat.h>
 #include <obj_parse.h>
+#include <preview.h>
+#include <raster.h>
+
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #define CYLIBX_ALLOC
 #include <cylibx.h>
@@ -13,6 +20,64 @@ enum CubeMarchingState {
 	ERROR_HAPPEND,
 	FINISHED,
 };
+// pause in typing after which the text gets compiled in the background
+#define LIVE_COMPILE_DEBOUNCE 0.35
+// how often a running gcc gets polled while the loop would otherwise sleep, in milliseconds
+// the mesh, preview and export threads wake the loop themselves once they are done
+#define LIVE_POLL_MS 20
+// how often the progress of an export gets redrawn
+#define LIVE_EXPORT_POLL_MS 250
+// grid resolution of a still mesh, formulas using `t` drop down to LIVE_MIN_RES to keep up with the frames
+// (from SPARSE_MIN_RES up only the bricks around the surface are sampled, so this can be well above the dense limit)
+#define LIVE_MESH_RES 256
+// explicit `z - g(x, y)` formulas only sample a plane so they can afford a much finer grid
+#define LIVE_HEIGHT_RES 1024
+// points along u and along v of a parametric surface
+#define LIVE_SURFACE_RES 256
+#define LIVE_MIN_RES 12
+// volumes get one lattice point per sample along their longest side, up to this
+#define LIVE_VOLUME_RES 1024
+#define LIVE_FRAME_BUDGET (1.0 / 60.0)
+// <C-e> streams the shown formula into a PLY file at this resolution, far above what fits in memory at once
+#define EXPORT_RES 2048
+#define EXPORT_DIR "./resources/exports/"
+// <C-p> records the frames into a PNG sequence in a directory of its own under this one
+#define CAPTURE_DIR "./resources/captures/"
+// the sphere traced preview shown until the mesh is out has this many times fewer pixels along each side
+#define PREVIEW_DOWNSCALE 2
+// scale of the function mesh in the 3D view, the preview has to match it
+#define SHAPE_SCALE 10.f
+// where the camera and the light start, rotated from VIEW_DISTANCE along x
+#define VIEW_YAW -45.0
+#define VIEW_PITCH 45.0
+#define VIEW_DISTANCE 3
+// size of the PNG `--snapshot` renders on the CPU
+#define SNAPSHOT_WIDTH 1280
+#define SNAPSHOT_HEIGHT 720
+typedef struct {
+	FormulaJob job;
+	MeshWorker worker;
+	MeshExport export;
+	PreviewJob preview;
+	// view the preview was last started with, it is traced again if the camera moves before the mesh is out
+	PreviewView preview_view;
+	uint8_t preview_on : 1;
+	// the preview has put pixels on screen, only from then on it stands in for the previous mesh
+	uint8_t preview_shown : 1;
+	// formula of the mesh on screen, kept alive to re-mesh it every frame when it uses `t`
+	Formula* shown;
+	uint32_t res;
+	char* seen_text;
+	char* err_msg;
+	double changed_at;
+	uint8_t mesh_requested : 1;
+	uint8_t has_mesh : 1;
+	uint8_t mesh_inflight : 1;
+	// level sets and meshlets of the shown mesh, handed to the shape once it exists
+	MeshLevels levels;
+	uint8_t levels_pending : 1;
+} LiveCompile;
+
 enum FileState {
 	FILE_NOTHING,
 	FILE_SAVE,
@@ -78,20 +143,33 @@ void main_setup(Context* ctx) {
 
 	grid_get_i(ctx, "calculating_cubes") = NOTHING;
 
-	grid_get_ptr(ctx, "indices") = cyx_array_new(uint32_t, &ctx->perm);
-	grid_get_ptr(ctx, "vertices") = cyx_array_new(float, &ctx->perm);
-	grid_get_f(ctx, "yaw") = -45.0;
-	grid_get_f(ctx, "pitch") = 45.0;
-	grid_get_v4(ctx, "camera") = vec4(3, 0, 0);
+	// swapped with the mesh worker buffers, so they can not live in the arena
+	grid_get_ptr(ctx, "indices") = cyx_array_new(uint32_t, NULL);
+	grid_get_ptr(ctx, "vertices") = cyx_array_new(float, NULL);
+	grid_get_ptr(ctx, "meshlets") = cyx_array_new(Meshlet, NULL);
+	grid_get_f(ctx, "yaw") = VIEW_YAW;
+	grid_get_f(ctx, "pitch") = VIEW_PITCH;
+	grid_get_v4(ctx, "camera") = vec4(VIEW_DISTANCE, 0, 0);
 
-	grid_get_f(ctx, "light_yaw") = -45.0;
-	grid_get_f(ctx, "light_pitch") = 45.0;
-	grid_get_v4(ctx, "light") = vec4(3, 0, 0);
+	grid_get_f(ctx, "light_yaw") = VIEW_YAW;
+	grid_get_f(ctx, "light_pitch") = VIEW_PITCH;
+	grid_get_v4(ctx, "light") = vec4(VIEW_DISTANCE, 0, 0);
 	grid_get_color(ctx, "light_color") = COLOR_WHITE;
 
 	grid_get_color(ctx, "shape_color") = COLOR_RED;
 
 	grid_get_ptr(ctx, "error_msg") = cyx_str_new(&ctx->perm);
+
+	LiveCompile* live = evo_alloc_malloc(&ctx->perm, sizeof(LiveCompile));
+	*live = (LiveCompile){
+		.seen_text = cyx_str_new(NULL),
+		.err_msg = cyx_str_new(NULL),
+		.res = LIVE_MESH_RES,
+	};
+	mesh_worker_start(&live->worker, context_wake);
+	live->preview.notify = context_wake;
+	live->export.notify = context_wake;
+	grid_get_ptr(ctx, "live_compile") = live;
 	grid_get_ptr(ctx, "graph_indices") = cyx_array_new(uint32_t, &ctx->perm);
 	grid_get_ptr(ctx, "graph_vertices") = cyx_array_new(float, &ctx->perm);
 
@@ -141,7 +219,357 @@ void main_setup(Context* ctx) {
 
 	grid_dyn_text(ctx, 0, "overlay_text", .padding = 15);
 }
+static void main_show_error(Context* ctx, const char* msg) {
+	char** err_msg = (char**)&grid_get_ptr(ctx, "error_msg");
+	cyx_str_clear(*err_msg);
+	cyx_str_append_lit(err_msg, msg);
+	cyx_str_append_char(err_msg, '\0');
+	cyx_str_replace(*err_msg, '\t', ' ');
+
+	grid_get_i(ctx, "calculating_cubes") = ERROR_HAPPEND;
+	grid_get_i(ctx, "file_overlay_on") = 1;
+	grid_get_i(ctx, "file_state") = SHOW_ERROR;
+}
+static void main_camera(Context* ctx, Vec4* camera, Vec4* light_pos) {
+	Vec4 pitch_vec = mat4_mult_vec4(mat4_rotation(grid_get_f(ctx, "pitch"), vec4(0, 0, 1)), grid_get_v4(ctx, "camera"));
+	*camera = mat4_mult_vec4(mat4_rotation(grid_get_f(ctx, "yaw"), vec4(0, 1, 0)), pitch_vec);
+
+	Mat4 pitch_mat = mat4_rotation(grid_get_f(ctx, "light_pitch"), vec4(0, 0, 1));
+	Mat4 yaw_mat = mat4_rotation(grid_get_f(ctx, "light_yaw"), vec4(0, 1, 0));
+	*light_pos = mat4_mult_vec4(yaw_mat, mat4_mult_vec4(pitch_mat, grid_get_v4(ctx, "light")));
+}
+static PreviewView main_preview_view(Context* ctx) {
+	PreviewView view = {
+		.light_color = grid_get_color(ctx, "light_color"),
+		.scale = SHAPE_SCALE,
+		.shininess = 128,
+		.reflectivity = 1.0f,
+	};
+	main_camera(ctx, &view.camera, &view.light_pos);
+	for (uint32_t l = 0; l < FORMULA_MAX_LEVELS; ++l) {
+		view.colors[l] = shape3d_range_color(grid_get_color(ctx, "shape_color"), l);
+	}
+
+	// the size of the 3D view is only known once the image has been laid out
+	ScenePair ret = grid_get(ctx, "preview", SHOWABLE_IMAGE);
+	Image* image = ret.ptr ? &((SceneShowable*)ret.ptr)->as.image : NULL;
+	int w = image && image->shown_w ? image->shown_w : ctx->wh.x;
+	int h = image && image->shown_h ? image->shown_h : ctx->wh.y / 2;
+	view.width = w / PREVIEW_DOWNSCALE;
+	view.height = h / PREVIEW_DOWNSCALE;
+	return view;
+}
+static void main_stop_preview(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	preview_cancel(&live->preview);
+	live->preview_on = 0;
+	live->preview_shown = 0;
+	ScenePair ret = grid_get(ctx, "preview", SHOWABLE_IMAGE);
+	if (ret.ptr) {
+		image_clear(&((SceneShowable*)ret.ptr)->as.image);
+	}
+}
+// shows the formula traced straight from its function while its mesh is being built, volumes and surfaces get none
+static void main_start_preview(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	CubeMarchDefintions defs = {
+		.left = -20.0, .right = 20.0,
+		.bottom = -20.0, .top = 20.0,
+		.near = -20.0, .far = 20.0,
+		.t = ctx->timer.elapsed,
+	};
+	live->preview_view = main_preview_view(ctx);
+	live->preview_on = preview_start(&live->preview, live->shown, defs, live->preview_view);
+	if (!live->preview_on) {
+		// whatever the last preview left on screen is not of this formula
+		main_stop_preview(ctx);
+	}
+}
+static void main_update_preview(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	if (!live->preview_on) { return; }
+
+	ScenePair ret = grid_get(ctx, "preview", SHOWABLE_IMAGE);
+	if (preview_take(&live->preview) && ret.ptr) {
+		image_update(&((SceneShowable*)ret.ptr)->as.image, live->preview.view.width, live->preview.view.height, live->preview.pixels);
+		live->preview_shown = 1;
+	}
+
+	if (live->preview.state != PREVIEW_RUNNING && live->shown) {
+		PreviewView view = main_preview_view(ctx);
+		if (memcmp(&view, &live->preview_view, sizeof(view))) {
+			main_start_preview(ctx);
+		}
+	}
+}
+static uint32_t main_volume_res(const Volume* volume) {
+	uint32_t res = volume->nx > volume->ny ? volume->nx : volume->ny;
+	res = res > volume->nz ? res : volume->nz;
+	return res < LIVE_VOLUME_RES ? res : LIVE_VOLUME_RES;
+}
+static void main_submit_mesh(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	CubeMarchDefintions defs = {
+		.res = live->res,
+		.left = -20.0, .right = 20.0,
+		.bottom = -20.0, .top = 20.0,
+		.near = -20.0, .far = 20.0,
+		.t = ctx->timer.elapsed,
+	};
+	if (live->shown->volume) {
+		// the volume keeps its proportions inside the usual box
+		const Volume* volume = live->shown->volume;
+		double longest = main_volume_res(volume) - 1;
+		defs.left = -20.0 * (volume->nx - 1) / longest; defs.right = -defs.left;
+		defs.bottom = -20.0 * (volume->ny - 1) / longest; defs.top = -defs.bottom;
+		defs.near = -20.0 * (volume->nz - 1) / longest; defs.far = -defs.near;
+	}
+
+	// supersedes (and cancels) whatever the worker was still marching
+	mesh_worker_submit(&live->worker, live->shown, defs);
+	live->mesh_inflight = 1;
+}
+static void main_request_mesh(Context* ctx, Formula* formula) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	if (live->shown) { formula_release(live->shown); }
+	live->shown = formula_retain(formula);
+	live->res = formula->volume ? main_volume_res(formula->volume) :
+		formula->surface ? LIVE_SURFACE_RES : formula->height ? LIVE_HEIGHT_RES : LIVE_MESH_RES;
+
+	main_submit_mesh(ctx);
+	main_start_preview(ctx);
+	grid_get_i(ctx, "calculating_cubes") = CALCULATING;
+}
+static void main_stop_mesh(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	mesh_worker_cancel(&live->worker);
+	live->mesh_inflight = 0;
+	main_stop_preview(ctx);
+	if (live->shown) {
+		formula_release(live->shown);
+		live->shown = NULL;
+	}
+}
+static void main_take_mesh(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	uint32_t** indices = (uint32_t**)&grid_get_ptr(ctx, "indices");
+	float** vertices = (float**)&grid_get_ptr(ctx, "vertices");
+	Meshlet** meshlets = (Meshlet**)&grid_get_ptr(ctx, "meshlets");
+
+	MeshStats stats = { 0 };
+	if (!mesh_worker_take(&live->worker, indices, vertices, &live->levels, meshlets, &stats)) { return; }
+	live->mesh_inflight = 0;
+	main_stop_preview(ctx);
+
+	if (live->shown && live->shown->uses_time) {
+		// the work grows with the cube of the resolution, or the square of it for heightfields and surfaces
+		double seconds = stats.seconds;
+		int planar = live->shown->height || live->shown->surface;
+		uint32_t max_res = live->shown->surface ? LIVE_SURFACE_RES : live->shown->height ? LIVE_HEIGHT_RES : LIVE_MESH_RES;
+		if (seconds > LIVE_FRAME_BUDGET) {
+			double scale = planar ? sqrt(LIVE_FRAME_BUDGET / seconds) : cbrt(LIVE_FRAME_BUDGET / seconds);
+			live->res = (uint32_t)(live->res * scale * 0.9);
+			if (live->res < LIVE_MIN_RES) { live->res = LIVE_MIN_RES; }
+		} else if (seconds < LIVE_FRAME_BUDGET / 2 && live->res < max_res) {
+			live->res += planar ? 16 : 2;
+			if (live->res > max_res) { live->res = max_res; }
+		}
+	} else {
+		if (stats.acmr[0] > 0) {
+			printf("LOG:\tVertex cache misses per triangle %.3f -> %.3f\n", stats.acmr[0], stats.acmr[1]);
+		}
+	}
+
+	ScenePair ret = grid_get(ctx, "shape3d", SHOWABLE_3D);
+	if (ret.ptr) {
+		shape3d_update(&((SceneShowable*)ret.ptr)->as.shape, *indices, *vertices);
+	}
+	live->levels_pending = 1;
+	live->has_mesh = 1;
+	grid_get_i(ctx, "calculating_cubes") = FINISHED;
+}
+static void main_toggle_export(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	if (live->export.state == EXPORT_RUNNING) {
+		mesh_export_cancel(&live->export);
+		return;
+	}
+
+	Formula* formula = live->shown ? live->shown : live->job.state == FORMULA_READY ? live->job.formula : NULL;
+	if (!formula) {
+		main_show_error(ctx, "ERROR:\tThere is no compiled function to export!");
+		return;
+	}
+	if (mkdir(EXPORT_DIR, 0755) && errno != EEXIST) {
+		main_show_error(ctx, "ERROR:\tCould not create the export directory!");
+		return;
+	}
+
+	char* path = cyx_str_from_lit(&ctx->temp, EXPORT_DIR);
+	char name[64];
+	snprintf(name, sizeof(name), "mesh-%ld.ply", (long)time(NULL));
+	cyx_str_append_lit(&path, name);
+	cyx_str_append_char(&path, '\0');
+	CubeMarchDefintions defs = {
+		.res = EXPORT_RES,
+		.left = -20.0, .right = 20.0,
+		.bottom = -20.0, .top = 20.0,
+		.near = -20.0, .far = 20.0,
+		.t = ctx->timer.elapsed,
+	};
+
+	char* err_msg = cyx_str_new(&ctx->temp);
+	if (!mesh_export_start(&live->export, formula, defs, path, &err_msg)) {
+		cyx_str_append_char(&err_msg, '\0');
+		main_show_error(ctx, err_msg);
+	}
+}
+static void main_toggle_capture(Context* ctx) {
+	if (!ctx->capture.active && mkdir(CAPTURE_DIR, 0755) && errno != EEXIST) {
+		main_show_error(ctx, "ERROR:\tCould not create the capture directory!");
+		return;
+	}
+
+	char dir[64];
+	snprintf(dir, sizeof(dir), CAPTURE_DIR "capture-%ld", (long)time(NULL));
+	context_toggle_capture(ctx, dir);
+}
+static void main_update_export(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	if (live->export.state != EXPORT_RUNNING) { return; }
+
+	switch (mesh_export_poll(&live->export)) {
+		case EXPORT_DONE: {
+			printf("LOG:\tExported [\"%s\"]\n", live->export.path);
+		} break;
+		case EXPORT_FAILED: {
+			cyx_str_append_char(&live->export.err_msg, '\0');
+			main_show_error(ctx, live->export.err_msg);
+			cyx_str_pop(&live->export.err_msg);
+		} break;
+		default: break;
+	}
+}
+// a file from the 'open file' overlay starting with VOLUME_MAGIC is meshed as sampled data instead of read as text
+static int main_open_volume(Context* ctx, const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (!file) { return 0; }
+	char magic[sizeof(VOLUME_MAGIC) - 1];
+	size_t read = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+	if (read != sizeof(magic) || memcmp(magic, VOLUME_MAGIC, sizeof(magic))) { return 0; }
+
+	char* err_msg = cyx_str_new(&ctx->temp);
+	Formula* formula = formula_from_volume(path, &err_msg);
+	if (!formula) {
+		cyx_str_append_char(&err_msg, '\0');
+		main_show_error(ctx, err_msg);
+		return 1;
+	}
+	main_request_mesh(ctx, formula);
+	formula_release(formula);
+	return 1;
+}
+static void main_update_compile(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	ScenePair ret = grid_get(ctx, "terminal_text", SHOWABLE_TEXT_INPUT);
+	if (!ret.ptr) { return; }
+	char* text = ((SceneShowable*)ret.ptr)->as.dyn_text.text;
+	double now = ctx->timer.prev_time;
+
+	if (!cyx_str_eq(text, live->seen_text)) {
+		cyx_str_clear(live->seen_text);
+		cyx_str_append_str(&live->seen_text, text);
+		live->changed_at = now;
+
+		// whatever was compiled or is compiling is for an older text now
+		formula_job_discard(&live->job);
+		cyx_str_clear(live->err_msg);
+	}
+
+	if (live->job.state == FORMULA_NOTHING && cyx_str_length(text) &&
+		(live->mesh_requested || now - live->changed_at >= LIVE_COMPILE_DEBOUNCE)) {
+		formula_job_start(&live->job, text, NULL, &live->err_msg);
+	}
+	formula_job_poll(&live->job, 0, &live->err_msg);
+
+	if (live->mesh_requested) {
+		if (live->job.state == FORMULA_READY) {
+			live->mesh_requested = 0;
+			main_request_mesh(ctx, live->job.formula);
+		} else if (live->job.state == FORMULA_ERROR) {
+			live->mesh_requested = 0;
+			cyx_str_append_char(&live->err_msg, '\0');
+			main_show_error(ctx, live->err_msg);
+			cyx_str_pop(&live->err_msg);
+			main_stop_mesh(ctx);
+		} else if (live->job.state == FORMULA_NOTHING) {
+			live->mesh_requested = 0;
+		}
+	}
+	main_take_mesh(ctx);
+	main_update_preview(ctx);
+	main_update_export(ctx);
+
+	// an animated formula gets re-meshed as soon as the previous frame of it is out
+	if (live->shown && live->shown->uses_time && !live->mesh_inflight && grid_get_i(ctx, "calculating_cubes") == FINISHED) {
+		main_submit_mesh(ctx);
+	}
+
+	// gcc and the export progress are only seen by polling, everything else wakes the loop up when it is done
+	if (live->job.state == FORMULA_COMPILING) {
+		context_wake_in(ctx, LIVE_POLL_MS);
+	}
+	if (live->export.state == EXPORT_RUNNING) {
+		context_wake_in(ctx, LIVE_EXPORT_POLL_MS);
+	}
+	if (live->job.state == FORMULA_NOTHING && cyx_str_length(text)) {
+		int debounce_ms = (live->changed_at + LIVE_COMPILE_DEBOUNCE - now) * 1000;
+		context_wake_in(ctx, debounce_ms > LIVE_POLL_MS ? debounce_ms : LIVE_POLL_MS);
+	}
+}
+static char* main_compile_status(Context* ctx, Color* color) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	char* status = cyx_str_new(&ctx->temp);
+	*color = COLOR_WHITE;
+	if (live->export.state == EXPORT_RUNNING) {
+		char progress[64];
+		snprintf(progress, sizeof(progress), "Exporting %d%%, <C-e> to cancel", (int)(100 * mesh_export_progress(&live->export)));
+		cyx_str_append_lit(&status, progress);
+		cyx_str_append_char(&status, '\0');
+		return status;
+	}
+	if (live->shown && live->shown->volume && grid_get_i(ctx, "calculating_cubes") == CALCULATING) {
+		cyx_str_append_lit(&status, "Building mesh...");
+		cyx_str_append_char(&status, '\0');
+		return status;
+	}
+	switch (live->job.state) {
+		case FORMULA_COMPILING: cyx_str_append_lit(&status, "Compiling..."); break;
+		case FORMULA_READY: {
+			if (grid_get_i(ctx, "calculating_cubes") == CALCULATING) {
+				cyx_str_append_lit(&status, "Building mesh...");
+			} else {
+				cyx_str_append_lit(&status, "Ready, <C-r> to render");
+			}
+		} break;
+		case FORMULA_ERROR: {
+			*color = COLOR_RED;
+			const char* prefix = "ERROR:\t";
+			size_t skip = strncmp(live->err_msg, prefix, strlen(prefix)) == 0 ? strlen(prefix) : 0;
+			for (size_t i = skip; i < cyx_str_length(live->err_msg) && live->err_msg[i] != '\n'; ++i) {
+				cyx_str_append_char(&status, live->err_msg[i]);
+			}
+		} break;
+		default: break;
+	}
+	if (!cyx_str_length(status)) { return NULL; }
+	cyx_str_append_char(&status, '\0');
+	return status;
+}
 void main_show(Context* ctx) {
+	main_update_compile(ctx);
+
 	grid_start(ctx, 0, GRID_VERTICAL, 1, 3, 4); {
 		grid_start(ctx, 0, GRID_HORIZONTAL, 10, 1); {
 			grid_text(ctx, 0, "f", "f(x,y,z)=0", .x = 15, .y = 15);
@@ -153,17 +581,21 @@ void main_show(Context* ctx) {
 			grid_rect(ctx, 0, "terminal_rect", COLOR_GRAY, .border_color = COLOR_WHITE, .border_width = 10, .padding = 10);
 			grid_dyn_text(ctx, 0, "terminal_text", .text_wrap = 1, .padding = 25);
 
+			Color status_color;
+			char* status = main_compile_status(ctx, &status_color);
+			if (status) {
+				grid_text(ctx, 1, "compile_status", status, .color = status_color, .x = 10, .center_y = 1);
+			}
+
 			grid_list_show(ctx, grid_get_list(ctx, "colors1"), 2, GRID_VERTICAL, 1, 1, 1, 1, 1);
 			grid_list_show(ctx, grid_get_list(ctx, "colors2"), 3, GRID_VERTICAL, 1, 1, 1, 1, 1);
 		} grid_end(ctx);
 
-		Vec4 pitch_vec = mat4_mult_vec4(mat4_rotation(grid_get_f(ctx, "pitch"), vec4(0, 0, 1)), grid_get_v4(ctx, "camera"));
-		Vec4 camera = mat4_mult_vec4(mat4_rotation(grid_get_f(ctx, "yaw"), vec4(0, 1, 0)), pitch_vec);
+		Vec4 camera, light_pos;
+		main_camera(ctx, &camera, &light_pos);
 
 		Mat4 pitch_mat = mat4_rotation(grid_get_f(ctx, "light_pitch"), vec4(0, 0, 1));
 		Mat4 yaw_mat = mat4_rotation(grid_get_f(ctx, "light_yaw"), vec4(0, 1, 0));
-
-		Vec4 light_pos = mat4_mult_vec4(yaw_mat, mat4_mult_vec4(pitch_mat, grid_get_v4(ctx, "light")));
 		Vec4 light_cube_pos = mat4_mult_vec4(yaw_mat, mat4_mult_vec4(pitch_mat, vec4_add(grid_get_v4(ctx, "light"), vec4(0.5, 0, 0))));
 		grid_shape(ctx, 2, "graph3d",
 			vec4(0, 0, 0),
@@ -195,11 +627,13 @@ void main_show(Context* ctx) {
 			.shininess = 128,
 			.reflectivity = 1.f,
 		);
-		if (grid_get_i(ctx, "calculating_cubes") == FINISHED) {
+		// the previous mesh stays up until the worker publishes the new one, unless a preview of the new one is on screen
+		LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+		if (grid_get_i(ctx, "calculating_cubes") == FINISHED || (grid_get_i(ctx, "calculating_cubes") == CALCULATING && live->has_mesh && !live->preview_shown)) {
 			grid_shape(ctx, 2, "shape3d",
 				vec4(0, 0, 0),
 				grid_get_color(ctx, "shape_color"),
-				10.f,
+				SHAPE_SCALE,
 				grid_get_ptr(ctx, "indices"),
 				grid_get_ptr(ctx, "vertices"),
 				camera,
@@ -211,7 +645,15 @@ void main_show(Context* ctx) {
 				.shininess = 128,
 				.reflectivity = 1.0f,
 			);
+			ScenePair ret = grid_get(ctx, "shape3d", SHOWABLE_3D);
+			if (ret.ptr && live->levels_pending) {
+				Meshlet* meshlets = grid_get_ptr(ctx, "meshlets");
+				shape3d_set_ranges(&((SceneShowable*)ret.ptr)->as.shape, live->levels.count, live->levels.ends);
+				shape3d_set_meshlets(&((SceneShowable*)ret.ptr)->as.shape, meshlets, cyx_array_length(meshlets));
+				live->levels_pending = 0;
+			}
 		}
+		grid_image(ctx, 2, "preview", .padding = 20);
 		grid_rect(ctx, 2, "shape_rect", COLOR_NONE, .border_color = COLOR_WHITE, .border_width = 10, .padding = 10);
 		if (grid_get_i(ctx, "show_name")){
 			grid_text(ctx, 2, "name", "Filip Conic, RA126/2022", .x = -400, .y = -10, .padding = 20);
@@ -244,10 +686,16 @@ void main_show(Context* ctx) {
 								"<C-l>      : Turn on/off FPS cap\n"
 								"<ESC>      : Turn off the application\n\n"
 								"<C-o>      : Show the 'open file' overlay where you can open a saved function\n"
+								"             or a raw volume file\n"
 								"<C-s>      : Show the 'save file' overlay where you can save a function you have\n"
 								"             currently written\n"
 								"<C-i>      : Select the main input box\n"
-								"<C-r>      : Compile the function you've written\n\n"
+								"<C-r>      : Compile the function you've written, use 't' for the time in seconds\n"
+								"             or write '(x(u,v), y(u,v), z(u,v))' for a parametric surface\n"
+								"             and 'f = c1, c2, ...' for several level sets of f at once\n"
+								"<C-e>      : Export the shown function as a fine PLY mesh into 'resources/exports',\n"
+								"             press again to cancel\n"
+								"<C-p>      : Record the frames as PNGs into 'resources/captures', press again to stop\n\n"
 								"WASD       : Move the camera around on a sphere\n"
 								"<C-'+'>    : Move the camera closer to the (0, 0)\n"
 								"<C-'-'>    : Move the camera away from (0, 0)\n"
@@ -273,59 +721,15 @@ void main_show(Context* ctx) {
 void main_key(Context* ctx, char key, int value) {
 	if (key == 'r' && ctx->key_info.ctrl_held) {
 		push_event(ctx, EVENT_TURN_OFF_INPUT);
-		char* str = cyx_str_copy_a(&ctx->temp, grid_get_text(ctx, "terminal_text"));
-		printf(CYX_STR_FMT"\n", CYX_STR_UNPACK(str));
-		char** err_msg = (char**)&grid_get_ptr(ctx, "error_msg");
-
-		uint32_t** indices = (uint32_t**)&grid_get_ptr(ctx, "indices");
-		float** vertices = (float**)&grid_get_ptr(ctx, "vertices");
-
-		CubeMarchDefintions defs = {
-			.res = 50,
-			.left = -20.0, .right = 20.0,
-			.bottom = -20.0, .top = 20.0,
-			.near = -20.0, .far = 20.0,
-		};
-
-		if (grid_get_i(ctx, "calculating_cubes") == NOTHING) {
-			grid_get_i(ctx, "calculating_cubes") = CALCULATING;
-
-			if (!cube_march(indices, vertices, str, NULL, defs, err_msg)) {
-				cyx_str_append_char(err_msg, '\0');
-				cyx_str_replace(*err_msg, '\t', ' ');
-				grid_get_i(ctx, "calculating_cubes") = ERROR_HAPPEND;
-				grid_get_i(ctx, "file_overlay_on") = 1;
-				grid_get_i(ctx, "file_state") = SHOW_ERROR;
-			} else {
-				printf("here success!\n");
-				grid_get_i(ctx, "calculating_cubes") = FINISHED;
-			}
-		} else if (grid_get_i(ctx, "calculating_cubes") == FINISHED || grid_get_i(ctx, "calculating_cubes") == ERROR_HAPPEND) {
-			grid_get_i(ctx, "calculating_cubes") = CALCULATING;
-		
-			ScenePair ret = grid_get(ctx, "shape3d", SHOWABLE_3D);
-			if (ret.ptr) { shape3d_free(ret.ptr); }
-			cyx_array_clear(*indices);
-			cyx_array_clear(*vertices);
-
-			if (!cube_march(indices, vertices, str, NULL, defs, err_msg)) {
-				cyx_str_append_char(err_msg, '\0');
-				cyx_str_replace(*err_msg, '\t', ' ');
-				grid_get_i(ctx, "calculating_cubes") = ERROR_HAPPEND;
-				grid_get_i(ctx, "file_overlay_on") = 1;
-				grid_get_i(ctx, "file_state") = SHOW_ERROR;
-			} else {
-				if (ret.ptr) {
-					((SceneShowable*)ret.ptr)->as.shape = shape3d_create(
-						ctx->programs[PROGRAM_3D],
-						grid_get_color(ctx, "shape_color"),
-						20.f, *indices, *vertices
-					);
-				}
-				printf("success!\n");
-				grid_get_i(ctx, "calculating_cubes") = FINISHED;
-			}
+		// the mesh gets built as soon as the (most likely already running) compile of the current text is done
+		LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+		live->mesh_requested = 1;
+		// an older mesh still being built is of no use anymore
+		main_stop_mesh(ctx);
+		if (grid_get_i(ctx, "calculating_cubes") == CALCULATING) {
+			grid_get_i(ctx, "calculating_cubes") = live->has_mesh ? FINISHED : NOTHING;
 		}
+		main_update_compile(ctx);
 	}
 
 	if (!ctx->curr_text_input && !grid_get_i(ctx, "file_overlay_on")) {
@@ -434,6 +838,12 @@ void main_key(Context* ctx, char key, int value) {
 					ctx->showable_clicked = ret.ptr;
 					push_event(ctx, EVENT_SHOWABLE_CLICKED);
 				} break;
+				case 'e': {
+					main_toggle_export(ctx);
+				} break;
+				case 'p': {
+					main_toggle_capture(ctx);
+				} break;
 				case 'h': {
 					grid_get_i(ctx, "file_overlay_on") = 1;
 					push_event(ctx, EVENT_TURN_OFF_INPUT);
@@ -483,16 +893,16 @@ void main_key(Context* ctx, char key, int value) {
 					--cyx_str_length(file_path);
 					cyx_str_append_char(&file_path, '\0');
 
+					grid_get_i(ctx, "file_overlay_on") = 0;
+					grid_get_i(ctx, "file_state") = FILE_NOTHING;
+					push_event(ctx, EVENT_TURN_OFF_INPUT);
+
 					ScenePair ret = grid_get(ctx, "terminal_text", SHOWABLE_TEXT_INPUT);
-					if (ret.ptr) {
+					if (ret.ptr && !main_open_volume(ctx, file_path)) {
 						cyx_str_clear(((SceneShowable*)ret.ptr)->as.dyn_text.text);
 						char* file_text = cyx_str_from_file(&ctx->temp, file_path);
 						cyx_str_append_str(&((SceneShowable*)ret.ptr)->as.dyn_text.text, file_text);
 					}
-
-					grid_get_i(ctx, "file_overlay_on") = 0;
-					grid_get_i(ctx, "file_state") = FILE_NOTHING;
-					push_event(ctx, EVENT_TURN_OFF_INPUT);
 				}
 			}
 		}
@@ -502,6 +912,25 @@ void main_key(Context* ctx, char key, int value) {
 		grid_get_i(ctx, "show_name") = !grid_get_i(ctx, "show_name");
 	}
 }
+// a compile, a mesh, an export or a preview still going on at exit would outlive the window, gcc and its files included
+void main_cleanup(Context* ctx) {
+	LiveCompile* live = grid_get_ptr(ctx, "live_compile");
+	formula_job_discard(&live->job);
+	mesh_export_stop(&live->export);
+	preview_free(&live->preview);
+	live->preview_on = 0;
+	mesh_worker_stop(&live->worker);
+	if (live->shown) {
+		formula_release(live->shown);
+		live->shown = NULL;
+	}
+	cyx_str_free(live->seen_text);
+	cyx_str_free(live->err_msg);
+
+	cyx_array_free(grid_get_ptr(ctx, "indices"));
+	cyx_array_free(grid_get_ptr(ctx, "vertices"));
+	cyx_array_free(grid_get_ptr(ctx, "meshlets"));
+}
 
 SceneDescription scenes[] = { 
 	{
@@ -509,11 +938,100 @@ SceneDescription scenes[] = {
 		.setup = main_setup,
 		.show = main_show,
 		.key_callback = main_key,
+		.cleanup = main_cleanup,
 	},
 };
 
-int main() {
+// meshes `equation` and draws it the way the 3D view starts out into a PNG, on the CPU so it works without a display
+static int main_snapshot(const char* equation, const char* path) {
+	char* err_msg = cyx_str_new(NULL);
+	char* text = cyx_str_from_lit(NULL, equation);
+	FormulaJob job = { 0 };
+	if (!formula_job_start(&job, text, NULL, &err_msg) || formula_job_poll(&job, 1, &err_msg) != FORMULA_READY) {
+		fprintf(stderr, "%s", err_msg);
+		formula_job_discard(&job);
+		cyx_str_free(text);
+		cyx_str_free(err_msg);
+		return 0;
+	}
+
+	Formula* formula = job.formula;
+	CubeMarchDefintions defs = {
+		.res = formula->surface ? LIVE_SURFACE_RES : formula->height ? LIVE_HEIGHT_RES : LIVE_MESH_RES,
+		.left = -20.0, .right = 20.0,
+		.bottom = -20.0, .top = 20.0,
+		.near = -20.0, .far = 20.0,
+	};
+	uint32_t* indices = cyx_array_new(uint32_t, NULL);
+	float* vertices = cyx_array_new(float, NULL);
+	MeshLevels levels = { 0 };
+	int ok = cube_march_formula(&indices, &vertices, &levels, formula, defs, NULL);
+	formula_job_discard(&job);
+	cyx_str_free(text);
+	cyx_str_free(err_msg);
+	if (!ok) {
+		fprintf(stderr, "ERROR:\tUnable to mesh [\"%s\"]!\n", equation);
+		cyx_array_free(indices);
+		cyx_array_free(vertices);
+		return 0;
+	}
+
+	Mat4 rotation = mat4_mult(mat4_rotation(VIEW_YAW, vec4(0, 1, 0)), mat4_rotation(VIEW_PITCH, vec4(0, 0, 1)));
+	Shape3D shape = {
+		.color = COLOR_RED,
+		.pos = vec4(0, 0, 0),
+		.scale = SHAPE_SCALE,
+		.camera = mat4_mult_vec4(rotation, vec4(VIEW_DISTANCE, 0, 0)),
+		.light_pos = mat4_mult_vec4(rotation, vec4(VIEW_DISTANCE, 0, 0)),
+		.light_color = COLOR_WHITE,
+		.shininess = 128,
+		.reflectivity = 1.f,
+		.face_cull = 1,
+		.depth_test = 1,
+	};
+	// every level set in a colour of its own, as in the 3D view
+	shape3d_set_ranges(&shape, levels.count, levels.ends);
+	Rectangle frame = { .color = COLOR_NONE, .border_color = COLOR_WHITE, .border_width = 10 };
+
+	Raster raster;
+	if (!raster_start(&raster, SNAPSHOT_WIDTH, SNAPSHOT_HEIGHT)) {
+		cyx_array_free(indices);
+		cyx_array_free(vertices);
+		return 0;
+	}
+	raster_clear(&raster, COLOR_GRAY);
+	// the same paddings the mesh and its frame get in the 3D view
+	raster_shape3d(&raster, &shape, indices, cyx_array_length(indices), vertices, cyx_array_length(vertices) / MESH_VERTEX_FLOATS,
+		20, 20, SNAPSHOT_WIDTH - 40, SNAPSHOT_HEIGHT - 40);
+	raster_rect(&raster, &frame, 10, 10, SNAPSHOT_WIDTH - 20, SNAPSHOT_HEIGHT - 20);
+	ok = raster_write_png(&raster, path);
+	if (ok) {
+		printf("LOG:\tWrote %u triangles to [\"%s\"]\n", (uint32_t)cyx_array_length(indices) / 3, path);
+	}
+	raster_stop(&raster);
+	cyx_array_free(indices);
+	cyx_array_free(vertices);
+	return ok;
+}
+
+int main(int argc, char** argv) {
 	Context ctx = { 0 };
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--sdf-text")) {
+			ctx.font_backend = FONT_SDF;
+		} else if (!strcmp(argv[i], "--no-program-cache")) {
+			ctx.program_cache_off = 1;
+		} else if (!strcmp(argv[i], "--snapshot")) {
+			if (i + 2 >= argc) {
+				fprintf(stderr, "ERROR:\tUsage: --snapshot <formula> <out.png>\n");
+				return 1;
+			}
+			return !main_snapshot(argv[i + 1], argv[i + 2]);
+		} else {
+			fprintf(stderr, "ERROR:\tUnknown argument [\"%s\"]!\n", argv[i]);
+			return 1;
+		}
+	}
 
 	context_setup(&ctx, sizeof(scenes)/sizeof(*scenes), scenes);
 	// glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -257,6 +257,56 @@ Mat4* mat4_transpose_self(Mat4* self) {
 
 	return self;
 }
+// cofactors over 2x2 sub-determinants of the top and bottom two rows
+inline Mat4 mat4_inverse(Mat4 mat) {
+	const float* m = mat.data;
+	float s0 = m[0] * m[5] - m[1] * m[4];
+	float s1 = m[0] * m[6] - m[2] * m[4];
+	float s2 = m[0] * m[7] - m[3] * m[4];
+	float s3 = m[1] * m[6] - m[2] * m[5];
+	float s4 = m[1] * m[7] - m[3] * m[5];
+	float s5 = m[2] * m[7] - m[3] * m[6];
+
+	float c5 = m[10] * m[15] - m[11] * m[14];
+	float c4 = m[9] * m[15] - m[11] * m[13];
+	float c3 = m[9] * m[14] - m[10] * m[13];
+	float c2 = m[8] * m[15] - m[11] * m[12];
+	float c1 = m[8] * m[14] - m[10] * m[12];
+	float c0 = m[8] * m[13] - m[9] * m[12];
+
+	float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (det == 0.f) { return (Mat4){ 0 }; }
+	float inv = 1.f / det;
+
+	return (Mat4){ .data = {
+		( m[5] * c5 - m[6] * c4 + m[7] * c3) * inv,
+		(-m[1] * c5 + m[2] * c4 - m[3] * c3) * inv,
+		( m[13] * s5 - m[14] * s4 + m[15] * s3) * inv,
+		(-m[9] * s5 + m[10] * s4 - m[11] * s3) * inv,
+
+		(-m[4] * c5 + m[6] * c2 - m[7] * c1) * inv,
+		( m[0] * c5 - m[2] * c2 + m[3] * c1) * inv,
+		(-m[12] * s5 + m[14] * s2 - m[15] * s1) * inv,
+		( m[8] * s5 - m[10] * s2 + m[11] * s1) * inv,
+
+		( m[4] * c4 - m[5] * c2 + m[7] * c0) * inv,
+		(-m[0] * c4 + m[1] * c2 - m[3] * c0) * inv,
+		( m[12] * s4 - m[13] * s2 + m[15] * s0) * inv,
+		(-m[8] * s4 + m[9] * s2 - m[11] * s0) * inv,
+
+		(-m[4] * c3 + m[5] * c1 - m[6] * c0) * inv,
+		( m[0] * c3 - m[1] * c1 + m[2] * c0) * inv,
+		(-m[12] * s3 + m[13] * s1 - m[14] * s0) * inv,
+		( m[8] * s3 - m[9] * s1 + m[10] * s0) * inv,
+	}};
+}
+Mat4* mat4_inverse_self(Mat4* self) {
+	*self = mat4_inverse(*self);
+	return self;
+}
+inline Mat4 mat4_normal(Mat4 model) {
+	return mat4_transpose(mat4_inverse(model));
+}
 
 /*
  *  0  1  2  3
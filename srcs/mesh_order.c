@@ -0,0 +1,303 @@
+#include <mesh_order.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CYLIBX_ALLOC
+#include <cylibx.h>
+
+#define MESH_ORDER_NONE UINT32_MAX
+// lambda of Tipsify's overdraw pass: a cluster may end once its own ACMR, from a cold cache, is no worse than
+// this many times the ACMR of the dead end run it was cut from
+#define MESH_ORDER_LAMBDA 1.05
+
+double mesh_acmr(EvoArena* arena, const uint32_t* indices, size_t index_count, uint32_t vertex_count, uint32_t cache_size) {
+	if (index_count < 3) { return 0; }
+
+	// a vertex is in the FIFO as long as fewer than cache_size misses happened since it got in
+	size_t* entered = evo_arena_malloc(arena, vertex_count * sizeof(size_t));
+	for (uint32_t v = 0; v < vertex_count; ++v) { entered[v] = SIZE_MAX; }
+	size_t misses = 0;
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t v = indices[i];
+		if (entered[v] == SIZE_MAX || misses - entered[v] >= cache_size) {
+			entered[v] = misses++;
+		}
+	}
+	return (double)misses / (index_count / 3);
+}
+
+typedef struct {
+	float metric;
+	uint32_t begin, count;
+} MeshCluster;
+
+static int mesh_cluster_cmp(const void* a, const void* b) {
+	float x = ((const MeshCluster*)a)->metric, y = ((const MeshCluster*)b)->metric;
+	return (x < y) - (x > y);
+}
+// triangles facing away from the middle of the mesh are drawn first, they are the ones most likely to cover the rest
+static void mesh_sort_clusters(EvoArena* arena, uint32_t* indices, size_t index_count, const float* vertices, MeshCluster* clusters, size_t cluster_count) {
+	double center[3] = { 0 };
+	for (size_t i = 0; i < index_count; ++i) {
+		for (size_t c = 0; c < 3; ++c) { center[c] += vertices[MESH_VERTEX_FLOATS * indices[i] + c]; }
+	}
+	for (size_t c = 0; c < 3; ++c) { center[c] /= index_count; }
+
+	for (size_t k = 0; k < cluster_count; ++k) {
+		MeshCluster* cluster = &clusters[k];
+		double centroid[3] = { 0 }, normal[3] = { 0 };
+		for (uint32_t t = cluster->begin; t < cluster->begin + cluster->count; ++t) {
+			const float* a = &vertices[MESH_VERTEX_FLOATS * indices[3 * t + 0]];
+			const float* b = &vertices[MESH_VERTEX_FLOATS * indices[3 * t + 1]];
+			const float* c = &vertices[MESH_VERTEX_FLOATS * indices[3 * t + 2]];
+			double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			// area weighted, the cross product is twice the area
+			normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+			normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+			normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+			for (size_t i = 0; i < 3; ++i) { centroid[i] += (a[i] + b[i] + c[i]) / 3.0; }
+		}
+		double metric = 0;
+		for (size_t i = 0; i < 3; ++i) {
+			metric += (centroid[i] / cluster->count - center[i]) * normal[i];
+		}
+		double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		cluster->metric = length > 0 ? metric / length : 0;
+	}
+	qsort(clusters, cluster_count, sizeof(MeshCluster), mesh_cluster_cmp);
+
+	uint32_t* sorted = evo_arena_malloc(arena, index_count * sizeof(uint32_t));
+	size_t at = 0;
+	for (size_t k = 0; k < cluster_count; ++k) {
+		memcpy(sorted + at, indices + 3 * clusters[k].begin, 3 * clusters[k].count * sizeof(uint32_t));
+		at += 3 * clusters[k].count;
+	}
+	memcpy(indices, sorted, index_count * sizeof(uint32_t));
+}
+
+// the runs between dead ends get split further wherever the part of the run so far reached the target ACMR,
+// splitting flushes the cache, so the target is measured from a cold one; `time` goes on from where the ordering left
+// `cache_time`, and `split` needs room for a cluster per triangle
+static size_t mesh_split_clusters(const uint32_t* indices, uint32_t* cache_time, uint32_t time, uint32_t cache_size, const MeshCluster* runs, size_t run_count, MeshCluster* split) {
+	size_t split_count = 0;
+	#define mesh_cache_misses(t, misses) do { \
+		for (size_t c = 0; c < 3; ++c) { \
+			uint32_t v = indices[3 * (t) + c]; \
+			if (time - cache_time[v] > cache_size) { cache_time[v] = time++; ++(misses); } \
+		} \
+	} while (0)
+	for (size_t r = 0; r < run_count; ++r) {
+		uint32_t begin = runs[r].begin, end = runs[r].begin + runs[r].count;
+
+		size_t misses = 0;
+		time += cache_size + 1;
+		for (uint32_t t = begin; t < end; ++t) { mesh_cache_misses(t, misses); }
+		double target = MESH_ORDER_LAMBDA * misses / runs[r].count;
+
+		size_t first = split_count;
+		uint32_t start = begin;
+		misses = 0;
+		time += cache_size + 1;
+		for (uint32_t t = begin; t < end; ++t) {
+			mesh_cache_misses(t, misses);
+			if ((double)misses / (t + 1 - start) <= target) {
+				split[split_count++] = (MeshCluster){ .begin = start, .count = t + 1 - start };
+				start = t + 1;
+				misses = 0;
+				time += cache_size + 1;
+			}
+		}
+		if (start < end) {
+			// the tail never reached the target, so it rather goes with the cluster before it
+			if (split_count > first) {
+				split[split_count - 1].count += end - start;
+			} else {
+				split[split_count++] = (MeshCluster){ .begin = start, .count = end - start };
+			}
+		}
+	}
+	#undef mesh_cache_misses
+	return split_count;
+}
+
+void mesh_order_triangles(EvoArena* arena, uint32_t* indices, size_t index_count, const float* vertices, uint32_t vertex_count, uint32_t cache_size) {
+	size_t triangle_count = index_count / 3;
+	if (triangle_count < 2) { return; }
+
+	// triangles around every vertex, packed one vertex after the other
+	uint32_t* offsets = evo_arena_calloc(arena, vertex_count + 1, sizeof(uint32_t));
+	for (size_t i = 0; i < index_count; ++i) { ++offsets[indices[i] + 1]; }
+	for (uint32_t v = 0; v < vertex_count; ++v) { offsets[v + 1] += offsets[v]; }
+	uint32_t* adjacency = evo_arena_malloc(arena, index_count * sizeof(uint32_t));
+	uint32_t* fill = evo_arena_malloc(arena, vertex_count * sizeof(uint32_t));
+	memcpy(fill, offsets, vertex_count * sizeof(uint32_t));
+	for (size_t i = 0; i < index_count; ++i) { adjacency[fill[indices[i]]++] = i / 3; }
+
+	// triangles not emitted yet around every vertex, and when it last entered the cache
+	uint32_t* live = fill;
+	for (uint32_t v = 0; v < vertex_count; ++v) { live[v] = offsets[v + 1] - offsets[v]; }
+	uint32_t* cache_time = evo_arena_calloc(arena, vertex_count, sizeof(uint32_t));
+	uint8_t* emitted = evo_arena_calloc(arena, triangle_count, sizeof(uint8_t));
+	// vertices of the last emitted triangles, the first place to look when the fan runs dry
+	uint32_t* dead_end = evo_arena_malloc(arena, index_count * sizeof(uint32_t));
+	size_t dead_end_count = 0;
+	uint32_t* candidates = evo_arena_malloc(arena, index_count * sizeof(uint32_t));
+	uint32_t* out = evo_arena_malloc(arena, index_count * sizeof(uint32_t));
+	MeshCluster* clusters = evo_arena_malloc(arena, triangle_count * sizeof(MeshCluster));
+	size_t cluster_count = 0;
+
+	uint32_t time = cache_size + 1;
+	uint32_t cursor = 0;
+	size_t emitted_count = 0;
+	uint32_t fan = indices[0];
+	while (fan != MESH_ORDER_NONE) {
+		size_t candidate_count = 0;
+		for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+			uint32_t t = adjacency[a];
+			if (emitted[t]) { continue; }
+			emitted[t] = 1;
+			for (size_t c = 0; c < 3; ++c) {
+				uint32_t v = indices[3 * t + c];
+				out[3 * emitted_count + c] = v;
+				dead_end[dead_end_count++] = v;
+				candidates[candidate_count++] = v;
+				--live[v];
+				if (time - cache_time[v] > cache_size) {
+					cache_time[v] = time++;
+				}
+			}
+			++emitted_count;
+		}
+
+		// the candidate that stays in the cache the longest while it still has triangles left
+		uint32_t next = MESH_ORDER_NONE;
+		int64_t best = -1;
+		for (size_t i = 0; i < candidate_count; ++i) {
+			uint32_t v = candidates[i];
+			if (!live[v]) { continue; }
+			int64_t priority = 0;
+			if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+				priority = time - cache_time[v];
+			}
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+		if (next == MESH_ORDER_NONE) {
+			// a dead end, the triangles emitted since the last one make up a run that gets split into clusters later
+			size_t begin = cluster_count ? clusters[cluster_count - 1].begin + clusters[cluster_count - 1].count : 0;
+			if (emitted_count > begin) {
+				clusters[cluster_count++] = (MeshCluster){ .begin = begin, .count = emitted_count - begin };
+			}
+			while (dead_end_count && next == MESH_ORDER_NONE) {
+				uint32_t v = dead_end[--dead_end_count];
+				if (live[v]) { next = v; }
+			}
+			while (next == MESH_ORDER_NONE && cursor < vertex_count) {
+				if (live[cursor]) { next = cursor; }
+				++cursor;
+			}
+		}
+		fan = next;
+	}
+
+	memcpy(indices, out, emitted_count * 3 * sizeof(uint32_t));
+	MeshCluster* split = evo_arena_malloc(arena, triangle_count * sizeof(MeshCluster));
+	cluster_count = mesh_split_clusters(indices, cache_time, time, cache_size, clusters, cluster_count, split);
+	mesh_sort_clusters(arena, indices, emitted_count * 3, vertices, split, cluster_count);
+}
+
+void mesh_order_vertices(EvoArena* arena, uint32_t* indices, size_t index_count, float* vertices, uint32_t vertex_count) {
+	uint32_t* remap = evo_arena_malloc(arena, vertex_count * sizeof(uint32_t));
+	for (uint32_t v = 0; v < vertex_count; ++v) { remap[v] = MESH_ORDER_NONE; }
+	float* sorted = evo_arena_malloc(arena, (size_t)vertex_count * MESH_VERTEX_FLOATS * sizeof(float));
+
+	uint32_t next = 0;
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t v = indices[i];
+		if (remap[v] == MESH_ORDER_NONE) {
+			remap[v] = next;
+			memcpy(sorted + (size_t)next * MESH_VERTEX_FLOATS, vertices + (size_t)v * MESH_VERTEX_FLOATS, MESH_VERTEX_FLOATS * sizeof(float));
+			++next;
+		}
+		indices[i] = remap[v];
+	}
+	// vertices no triangle uses keep their data behind the used ones
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		if (remap[v] != MESH_ORDER_NONE) { continue; }
+		memcpy(sorted + (size_t)next * MESH_VERTEX_FLOATS, vertices + (size_t)v * MESH_VERTEX_FLOATS, MESH_VERTEX_FLOATS * sizeof(float));
+		++next;
+	}
+	memcpy(vertices, sorted, (size_t)vertex_count * MESH_VERTEX_FLOATS * sizeof(float));
+}
+
+static Meshlet mesh_meshlet(const uint32_t* indices, const float* vertices, uint32_t first_index, uint32_t index_count) {
+	Meshlet meshlet = { .first_index = first_index, .index_count = index_count };
+
+	float lo[3] = { INFINITY, INFINITY, INFINITY }, hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+	double axis[3] = { 0 };
+	for (uint32_t i = first_index; i < first_index + index_count; i += 3) {
+		const float* p[3];
+		for (size_t c = 0; c < 3; ++c) {
+			p[c] = &vertices[MESH_VERTEX_FLOATS * indices[i + c]];
+			for (size_t k = 0; k < 3; ++k) {
+				if (p[c][k] < lo[k]) { lo[k] = p[c][k]; }
+				if (p[c][k] > hi[k]) { hi[k] = p[c][k]; }
+			}
+		}
+		double e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		double e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0) { continue; }
+		for (size_t k = 0; k < 3; ++k) { axis[k] += n[k] / length; }
+	}
+
+	float radius = 0;
+	for (size_t k = 0; k < 3; ++k) { meshlet.center[k] = 0.5f * (lo[k] + hi[k]); }
+	for (uint32_t i = first_index; i < first_index + index_count; ++i) {
+		const float* p = &vertices[MESH_VERTEX_FLOATS * indices[i]];
+		float dx = p[0] - meshlet.center[0], dy = p[1] - meshlet.center[1], dz = p[2] - meshlet.center[2];
+		float r = sqrtf(dx * dx + dy * dy + dz * dz);
+		if (r > radius) { radius = r; }
+	}
+	meshlet.radius = radius;
+
+	// the widest angle between the axis and any triangle normal decides the cone
+	meshlet.cone_cutoff = 1;
+	double axis_length = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	if (axis_length == 0) { return meshlet; }
+	for (size_t k = 0; k < 3; ++k) { meshlet.cone_axis[k] = axis[k] / axis_length; }
+	double min_dot = 1;
+	for (uint32_t i = first_index; i < first_index + index_count; i += 3) {
+		const float* a = &vertices[MESH_VERTEX_FLOATS * indices[i + 0]];
+		const float* b = &vertices[MESH_VERTEX_FLOATS * indices[i + 1]];
+		const float* c = &vertices[MESH_VERTEX_FLOATS * indices[i + 2]];
+		double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0) { continue; }
+		double d = (n[0] * meshlet.cone_axis[0] + n[1] * meshlet.cone_axis[1] + n[2] * meshlet.cone_axis[2]) / length;
+		if (d < min_dot) { min_dot = d; }
+	}
+	if (min_dot > 0) {
+		meshlet.cone_cutoff = sqrt(1 - min_dot * min_dot);
+	}
+	return meshlet;
+}
+void mesh_build_meshlets(Meshlet** meshlets, const uint32_t* indices, const float* vertices, uint32_t range_count, const uint32_t* range_ends) {
+	cyx_array_clear(*meshlets);
+	uint32_t begin = 0;
+	for (uint32_t r = 0; r < range_count; ++r) {
+		for (uint32_t first = begin; first < range_ends[r]; first += 3 * MESHLET_TRIANGLES) {
+			uint32_t count = range_ends[r] - first < 3 * MESHLET_TRIANGLES ? range_ends[r] - first : 3 * MESHLET_TRIANGLES;
+			cyx_array_append(*meshlets, mesh_meshlet(indices, vertices, first, count));
+		}
+		begin = range_ends[r];
+	}
+}
@@ -0,0 +1,110 @@
+#include <png.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t png_crc(uint32_t crc, const uint8_t* data, size_t size) {
+	static uint32_t table[256];
+	if (!table[1]) {
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (size_t k = 0; k < 8; ++k) {
+				c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+static void png_put_u32(uint8_t* out, uint32_t value) {
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+}
+static void png_write_chunk(FILE* file, const char* type, const uint8_t* data, uint32_t size) {
+	uint8_t header[8];
+	png_put_u32(header, size);
+	memcpy(header + 4, type, 4);
+	uint32_t crc = png_crc(png_crc(0, header + 4, 4), data, size);
+	uint8_t footer[4];
+	png_put_u32(footer, crc);
+	fwrite(header, 1, sizeof(header), file);
+	if (size) { fwrite(data, 1, size, file); }
+	fwrite(footer, 1, sizeof(footer), file);
+}
+// the image data goes into stored deflate blocks, so no compression library is needed
+int png_write(const char* path, uint32_t width, uint32_t height, const uint8_t* pixels, int bottom_up) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "ERROR:\tUnable to open file [\"%s\"]!\n", path);
+		return 0;
+	}
+
+	// every row starts with filter type 0
+	size_t row = (size_t)width * 4 + 1;
+	size_t raw_size = row * height;
+	uint8_t* raw = malloc(raw_size);
+	for (size_t y = 0; y < height; ++y) {
+		size_t source = bottom_up ? height - 1 - y : y;
+		raw[y * row] = 0;
+		memcpy(raw + y * row + 1, pixels + source * (row - 1), row - 1);
+	}
+
+	// 5552 bytes is the most that can be summed before the 32 bit sums could overflow
+	uint32_t adler_a = 1, adler_b = 0;
+	for (size_t i = 0; i < raw_size; i += 5552) {
+		size_t end = i + 5552 < raw_size ? i + 5552 : raw_size;
+		for (size_t j = i; j < end; ++j) {
+			adler_a += raw[j];
+			adler_b += adler_a;
+		}
+		adler_a %= 65521;
+		adler_b %= 65521;
+	}
+
+	size_t blocks = (raw_size + 0xFFFF - 1) / 0xFFFF;
+	size_t size = 2 + raw_size + 5 * blocks + 4;
+	uint8_t* data = malloc(size);
+	uint8_t* out = data;
+	*out++ = 0x78;
+	*out++ = 0x01;
+	for (size_t i = 0; i < raw_size; i += 0xFFFF) {
+		size_t length = raw_size - i < 0xFFFF ? raw_size - i : 0xFFFF;
+		*out++ = i + length == raw_size;
+		*out++ = length & 0xFF;
+		*out++ = length >> 8;
+		*out++ = ~length & 0xFF;
+		*out++ = (~length >> 8) & 0xFF;
+		memcpy(out, raw + i, length);
+		out += length;
+	}
+	png_put_u32(out, adler_b << 16 | adler_a);
+	free(raw);
+
+	uint8_t header[13];
+	png_put_u32(header, width);
+	png_put_u32(header + 4, height);
+	header[8] = 8;
+	header[9] = 6;
+	header[10] = header[11] = header[12] = 0;
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fwrite(signature, 1, sizeof(signature), file);
+	png_write_chunk(file, "IHDR", header, sizeof(header));
+	png_write_chunk(file, "IDAT", data, size);
+	png_write_chunk(file, "IEND", NULL, 0);
+	free(data);
+
+	int ok = !ferror(file);
+	if (fclose(file) || !ok) {
+		fprintf(stderr, "ERROR:\tUnable to write file [\"%s\"]!\n", path);
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,381 @@
+#include <preview.h>
+#include <shapes.h>
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// samples per side of the lattice the lipschitz bound is estimated on
+#define PREVIEW_LIPSCHITZ_RES 24
+// the estimate only sees the lattice, so it is stretched a bit for whatever lies between the samples
+#define PREVIEW_LIPSCHITZ_SAFETY 1.5
+#define PREVIEW_BISECTIONS 12
+
+typedef struct {
+	double x, y, z;
+} Vec3d;
+
+static inline Vec3d vec3d(double x, double y, double z) { return (Vec3d){ x, y, z }; }
+static inline Vec3d vec3d_add(Vec3d a, Vec3d b) { return vec3d(a.x + b.x, a.y + b.y, a.z + b.z); }
+static inline Vec3d vec3d_sub(Vec3d a, Vec3d b) { return vec3d(a.x - b.x, a.y - b.y, a.z - b.z); }
+static inline Vec3d vec3d_mult_s(Vec3d a, double s) { return vec3d(a.x * s, a.y * s, a.z * s); }
+static inline double vec3d_dot(Vec3d a, Vec3d b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline Vec3d vec3d_cross(Vec3d a, Vec3d b) {
+	return vec3d(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+static inline Vec3d vec3d_norm(Vec3d a) {
+	double len = sqrt(vec3d_dot(a, a));
+	return len > 0 ? vec3d_mult_s(a, 1.0 / len) : a;
+}
+
+// camera rays in the space of the formula, which shape3d_show scales down by `scale` around the origin
+typedef struct {
+	Vec3d eye;
+	Vec3d forward, right, up;
+	// tangents of the half angles of view, read off the same projection shape3d_show uses
+	double tan_x, tan_y;
+	Vec3d box_min, box_max;
+	double diagonal;
+} PreviewCamera;
+
+static PreviewCamera preview_camera(const PreviewJob* job) {
+	const PreviewView* view = &job->view;
+	PreviewCamera cam = {
+		.eye = vec3d(view->camera.x * view->scale, view->camera.y * view->scale, view->camera.z * view->scale),
+		.box_min = vec3d(job->defs.left, job->defs.bottom, job->defs.near),
+		.box_max = vec3d(job->defs.right, job->defs.top, job->defs.far),
+	};
+	cam.forward = vec3d_norm(vec3d_mult_s(cam.eye, -1));
+	cam.right = vec3d_norm(vec3d_cross(cam.forward, vec3d(0, 1, 0)));
+	cam.up = vec3d_cross(cam.right, cam.forward);
+
+	// a point at depth 1 in front of the eye ends up at w = -data[11] + data[15] in clip space
+	Mat4 proj = mat4_perspective(SHAPE3D_FOV, (float)view->width / view->height, SHAPE3D_NEAR, SHAPE3D_FAR);
+	double w = proj.data[15] - proj.data[11];
+	cam.tan_x = w / proj.data[0];
+	cam.tan_y = w / proj.data[5];
+
+	cam.diagonal = sqrt(vec3d_dot(vec3d_sub(cam.box_max, cam.box_min), vec3d_sub(cam.box_max, cam.box_min)));
+	return cam;
+}
+// part of the ray inside the box, returns 0 if it misses it
+static int preview_clip_ray(const PreviewCamera* cam, Vec3d dir, double* t_near, double* t_far) {
+	double lo = 0, hi = INFINITY;
+	double origin[3] = { cam->eye.x, cam->eye.y, cam->eye.z };
+	double d[3] = { dir.x, dir.y, dir.z };
+	double box_min[3] = { cam->box_min.x, cam->box_min.y, cam->box_min.z };
+	double box_max[3] = { cam->box_max.x, cam->box_max.y, cam->box_max.z };
+	for (size_t i = 0; i < 3; ++i) {
+		if (fabs(d[i]) < 1e-12) {
+			if (origin[i] < box_min[i] || origin[i] > box_max[i]) { return 0; }
+			continue;
+		}
+		double a = (box_min[i] - origin[i]) / d[i];
+		double b = (box_max[i] - origin[i]) / d[i];
+		if (a > b) { double tmp = a; a = b; b = tmp; }
+		if (a > lo) { lo = a; }
+		if (b < hi) { hi = b; }
+	}
+	*t_near = lo;
+	*t_far = hi;
+	return lo < hi;
+}
+
+// the largest central difference seen on a lattice over the box
+static double preview_lipschitz(Func f, CubeMarchDefintions defs, CancelToken* cancel) {
+	uint32_t n = PREVIEW_LIPSCHITZ_RES;
+	double dx = (defs.right - defs.left) / (n - 1);
+	double dy = (defs.top - defs.bottom) / (n - 1);
+	double dz = (defs.far - defs.near) / (n - 1);
+	double* values = malloc(n * n * n * sizeof(double));
+	// without a bound every step is max_step long, slower but still correct
+	if (!values) { return 0; }
+	for (uint32_t k = 0; k < n; ++k) {
+		if (cancel_token_is_set(cancel)) { free(values); return 0; }
+		for (uint32_t j = 0; j < n; ++j) {
+			for (uint32_t i = 0; i < n; ++i) {
+				values[(k * n + j) * n + i] = f(defs.left + i * dx, defs.bottom + j * dy, defs.near + k * dz, defs.t);
+			}
+		}
+	}
+
+	double bound = 0;
+	for (uint32_t k = 0; k + 1 < n; ++k) {
+		for (uint32_t j = 0; j + 1 < n; ++j) {
+			for (uint32_t i = 0; i + 1 < n; ++i) {
+				double v = values[(k * n + j) * n + i];
+				double gx = (values[(k * n + j) * n + i + 1] - v) / dx;
+				double gy = (values[(k * n + j + 1) * n + i] - v) / dy;
+				double gz = (values[((k + 1) * n + j) * n + i] - v) / dz;
+				double g = sqrt(gx * gx + gy * gy + gz * gz);
+				if (isfinite(g) && g > bound) { bound = g; }
+			}
+		}
+	}
+	free(values);
+	return bound * PREVIEW_LIPSCHITZ_SAFETY;
+}
+
+static inline double preview_level(const Formula* formula, uint32_t l) {
+	return formula->level_count ? formula->levels[l] : 0.0;
+}
+// lit colour of the first crossing of any level along the ray, a transparent pixel if there is none
+static void preview_trace(const PreviewJob* job, const PreviewCamera* cam, Vec3d dir, uint8_t* out) {
+	memset(out, 0, 4);
+	double t, t_far;
+	if (!preview_clip_ray(cam, dir, &t, &t_far)) { return; }
+
+	Func f = job->formula->func;
+	double time = job->defs.t;
+	uint32_t level_count = job->formula->level_count ? job->formula->level_count : 1;
+	double max_step = cam->diagonal * PREVIEW_MAX_STEP_FRACTION;
+	double min_step = cam->diagonal * PREVIEW_MIN_STEP_FRACTION;
+
+	Vec3d p = vec3d_add(cam->eye, vec3d_mult_s(dir, t));
+	double value = f(p.x, p.y, p.z, time);
+	int hit_level = -1;
+	double t_prev = t, value_prev = value;
+	for (uint32_t step = 0; step < PREVIEW_MAX_STEPS && hit_level < 0; ++step) {
+		// the surface is at least |f - c| / L away, but never step further than max_step
+		double distance = INFINITY;
+		for (uint32_t l = 0; l < level_count; ++l) {
+			double d = fabs(value - preview_level(job->formula, l));
+			if (d < distance) { distance = d; }
+		}
+		double advance = job->lipschitz > 0 ? distance / job->lipschitz : max_step;
+		advance = advance < min_step ? min_step : advance > max_step ? max_step : advance;
+		if (t >= t_far) { break; }
+
+		t_prev = t;
+		value_prev = value;
+		t = t + advance < t_far ? t + advance : t_far;
+		p = vec3d_add(cam->eye, vec3d_mult_s(dir, t));
+		value = f(p.x, p.y, p.z, time);
+
+		for (uint32_t l = 0; l < level_count; ++l) {
+			double c = preview_level(job->formula, l);
+			if ((value_prev - c) * (value - c) <= 0) { hit_level = l; break; }
+		}
+	}
+	if (hit_level < 0) { return; }
+
+	// the crossing is somewhere in [t_prev, t], halve the interval down to a fraction of a pixel
+	double c = preview_level(job->formula, hit_level);
+	double lo = t_prev, hi = t, value_lo = value_prev - c;
+	for (uint32_t i = 0; i < PREVIEW_BISECTIONS; ++i) {
+		double mid = 0.5 * (lo + hi);
+		Vec3d q = vec3d_add(cam->eye, vec3d_mult_s(dir, mid));
+		double v = f(q.x, q.y, q.z, time) - c;
+		if ((value_lo < 0) == (v < 0)) { lo = mid; value_lo = v; }
+		else { hi = mid; }
+	}
+	p = vec3d_add(cam->eye, vec3d_mult_s(dir, 0.5 * (lo + hi)));
+
+	// normals point along +grad f like the ones of the mesh, but always towards the camera
+	double h = cam->diagonal * 1e-5;
+	Vec3d normal = vec3d_norm(vec3d(
+		f(p.x + h, p.y, p.z, time) - f(p.x - h, p.y, p.z, time),
+		f(p.x, p.y + h, p.z, time) - f(p.x, p.y - h, p.z, time),
+		f(p.x, p.y, p.z + h, time) - f(p.x, p.y, p.z - h, time)
+	));
+	if (vec3d_dot(normal, normal) == 0) { normal = vec3d_mult_s(dir, -1); }
+	if (vec3d_dot(normal, dir) > 0) { normal = vec3d_mult_s(normal, -1); }
+
+	// the same phong model as shader3d.frag, in world space
+	const PreviewView* view = &job->view;
+	Vec3d frag = vec3d_mult_s(p, 1.0 / view->scale);
+	Vec3d light_dir = vec3d_norm(vec3d_sub(vec3d(view->light_pos.x, view->light_pos.y, view->light_pos.z), frag));
+	Vec3d view_dir = vec3d_norm(vec3d_sub(vec3d(view->camera.x, view->camera.y, view->camera.z), frag));
+	double diffuse = fmax(vec3d_dot(normal, light_dir), 0.0);
+	Vec3d reflected = vec3d_sub(vec3d_mult_s(normal, 2 * vec3d_dot(normal, light_dir)), light_dir);
+	double specular = view->reflectivity * pow(fmax(vec3d_dot(view_dir, reflected), 0.0), view->shininess);
+	double light = 0.2 + diffuse + specular;
+
+	Color color = view->colors[hit_level];
+	double lit[3] = {
+		light * view->light_color.r / 255.0 * color.r,
+		light * view->light_color.g / 255.0 * color.g,
+		light * view->light_color.b / 255.0 * color.b,
+	};
+	for (size_t i = 0; i < 3; ++i) {
+		out[i] = lit[i] > 255.0 ? 255 : (uint8_t)lit[i];
+	}
+	out[3] = 255;
+}
+
+static void* preview_tiles(void* arg) {
+	PreviewJob* job = arg;
+	CancelToken token = { .latest = &job->latest, .generation = job->generation };
+	CancelToken* cancel = &token;
+	PreviewCamera cam = preview_camera(job);
+
+	uint32_t width = job->view.width, height = job->view.height;
+	uint32_t tiles_x = (width + PREVIEW_TILE - 1) / PREVIEW_TILE;
+	uint32_t tiles = tiles_x * ((height + PREVIEW_TILE - 1) / PREVIEW_TILE);
+	for (uint32_t tile = atomic_fetch_add(&job->next_tile, 1); tile < tiles; tile = atomic_fetch_add(&job->next_tile, 1)) {
+		if (cancel_token_is_set(cancel)) { break; }
+
+		uint32_t x0 = (tile % tiles_x) * PREVIEW_TILE, y0 = (tile / tiles_x) * PREVIEW_TILE;
+		for (uint32_t y = y0; y < y0 + PREVIEW_TILE && y < height; ++y) {
+			double ny = 1.0 - 2.0 * (y + 0.5) / height;
+			for (uint32_t x = x0; x < x0 + PREVIEW_TILE && x < width; ++x) {
+				double nx = 2.0 * (x + 0.5) / width - 1.0;
+				Vec3d dir = vec3d_norm(vec3d_add(cam.forward, vec3d_add(
+					vec3d_mult_s(cam.right, nx * cam.tan_x),
+					vec3d_mult_s(cam.up, ny * cam.tan_y)
+				)));
+				preview_trace(job, &cam, dir, job->pixels + 4 * ((size_t)y * width + x));
+			}
+		}
+	}
+	return NULL;
+}
+static void* preview_helper_loop(void* arg) {
+	PreviewJob* job = arg;
+
+	uint32_t seen = 0;
+	pthread_mutex_lock(&job->lock);
+	for (;;) {
+		while (job->round == seen && !job->quit) {
+			pthread_cond_wait(&job->start, &job->lock);
+		}
+		if (job->quit) { break; }
+		seen = job->round;
+		pthread_mutex_unlock(&job->lock);
+
+		preview_tiles(job);
+
+		pthread_mutex_lock(&job->lock);
+		if (--job->running == 0) {
+			pthread_cond_signal(&job->tiles_done);
+		}
+	}
+	pthread_mutex_unlock(&job->lock);
+	return NULL;
+}
+static void preview_pool_start(PreviewJob* job) {
+	pthread_mutex_init(&job->lock, NULL);
+	pthread_cond_init(&job->start, NULL);
+	pthread_cond_init(&job->tiles_done, NULL);
+	job->round = job->running = 0;
+	job->quit = 0;
+
+	// the job thread takes tiles as well
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN) / PREVIEW_CPU_SHARE;
+	uint32_t wanted = cpus > 1 ? (uint32_t)cpus - 1 : 0;
+	if (wanted > PREVIEW_MAX_THREADS - 1) { wanted = PREVIEW_MAX_THREADS - 1; }
+	// a helper that could not be started only makes the preview slower
+	job->pool_started = 1;
+	job->helper_count = 0;
+	for (uint32_t i = 0; i < wanted; ++i) {
+		if (pthread_create(&job->helpers[job->helper_count], NULL, preview_helper_loop, job)) { break; }
+		++job->helper_count;
+	}
+}
+static void preview_pool_stop(PreviewJob* job) {
+	if (!job->pool_started) { return; }
+	pthread_mutex_lock(&job->lock);
+	job->quit = 1;
+	pthread_cond_broadcast(&job->start);
+	pthread_mutex_unlock(&job->lock);
+	for (uint32_t i = 0; i < job->helper_count; ++i) {
+		pthread_join(job->helpers[i], NULL);
+	}
+	pthread_mutex_destroy(&job->lock);
+	pthread_cond_destroy(&job->start);
+	pthread_cond_destroy(&job->tiles_done);
+	job->helper_count = 0;
+	job->pool_started = 0;
+}
+static void* preview_loop(void* arg) {
+	PreviewJob* job = arg;
+	CancelToken token = { .latest = &job->latest, .generation = job->generation };
+	CancelToken* cancel = &token;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	job->lipschitz = preview_lipschitz(job->formula->func, job->defs, cancel);
+	atomic_store(&job->next_tile, 0);
+
+	pthread_mutex_lock(&job->lock);
+	job->running = job->helper_count;
+	job->round++;
+	pthread_cond_broadcast(&job->start);
+	pthread_mutex_unlock(&job->lock);
+
+	preview_tiles(job);
+
+	pthread_mutex_lock(&job->lock);
+	while (job->running) {
+		pthread_cond_wait(&job->tiles_done, &job->lock);
+	}
+	pthread_mutex_unlock(&job->lock);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	job->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	job->result = !cancel_token_is_set(cancel);
+	atomic_store(&job->finished, 1);
+	if (job->result && job->notify) { job->notify(); }
+	return NULL;
+}
+
+int preview_start(PreviewJob* job, Formula* formula, CubeMarchDefintions defs, PreviewView view) {
+	if (!formula->func || !view.width || !view.height) { return 0; }
+	preview_cancel(job);
+
+	size_t size = (size_t)view.width * view.height * 4;
+	if (size > job->capacity) {
+		free(job->pixels);
+		job->pixels = malloc(size);
+		job->capacity = job->pixels ? size : 0;
+		if (!job->pixels) { return 0; }
+	}
+	if (!job->pool_started) {
+		preview_pool_start(job);
+	}
+
+	job->formula = formula_retain(formula);
+	job->defs = defs;
+	job->view = view;
+	job->generation = atomic_load(&job->latest);
+	atomic_store(&job->finished, 0);
+	if (pthread_create(&job->thread, NULL, preview_loop, job)) {
+		formula_release(job->formula);
+		job->formula = NULL;
+		return 0;
+	}
+	job->state = PREVIEW_RUNNING;
+	return 1;
+}
+PreviewState preview_poll(PreviewJob* job) {
+	if (job->state != PREVIEW_RUNNING || !atomic_load(&job->finished)) { return job->state; }
+
+	pthread_join(job->thread, NULL);
+	formula_release(job->formula);
+	job->formula = NULL;
+	job->state = job->result ? PREVIEW_DONE : PREVIEW_NOTHING;
+	return job->state;
+}
+int preview_take(PreviewJob* job) {
+	if (preview_poll(job) != PREVIEW_DONE) { return 0; }
+	job->state = PREVIEW_NOTHING;
+	return 1;
+}
+// waits for the tiles being traced right now, the rest of them are skipped
+void preview_cancel(PreviewJob* job) {
+	if (job->state != PREVIEW_RUNNING) { return; }
+	atomic_fetch_add(&job->latest, 1);
+	pthread_join(job->thread, NULL);
+	formula_release(job->formula);
+	job->formula = NULL;
+	job->state = PREVIEW_NOTHING;
+}
+void preview_free(PreviewJob* job) {
+	preview_cancel(job);
+	preview_pool_stop(job);
+	free(job->pixels);
+	job->pixels = NULL;
+	job->capacity = 0;
+}
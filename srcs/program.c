@@ -0,0 +1,273 @@
+#include <program.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <gl_state.h>
+
+#define CYLIBX_ALLOC
+#include <cylibx.h>
+
+static const char* uniform_names[UNIFORM_COUNT] = {
+	[UNIFORM_PROJ] = "u_proj",
+	[UNIFORM_MODEL] = "u_model",
+	[UNIFORM_NORMAL] = "u_normal",
+	[UNIFORM_COLOR] = "u_color",
+	[UNIFORM_SHININESS] = "u_shininess",
+	[UNIFORM_REFLECTIVITY] = "u_reflectivity",
+	[UNIFORM_TEXTURE] = "u_texture",
+};
+
+static const char* uniform_block_names[UNIFORM_BLOCK_COUNT] = {
+	[UNIFORM_BLOCK_CAMERA] = "Camera",
+};
+
+static void program_reflect(Program* program) {
+	for (size_t i = 0; i < UNIFORM_COUNT; ++i) {
+		program->uniforms[i] = -1;
+	}
+	for (size_t i = 0; i < UNIFORM_BLOCK_COUNT; ++i) {
+		uint32_t block = glGetUniformBlockIndex(program->id, uniform_block_names[i]);
+		if (block != GL_INVALID_INDEX) {
+			glUniformBlockBinding(program->id, block, i);
+		}
+	}
+
+	int count = 0;
+	glGetProgramiv(program->id, GL_ACTIVE_UNIFORMS, &count);
+	for (int i = 0; i < count; ++i) {
+		char name[64];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(program->id, i, sizeof(name), &length, &size, &type, name);
+		// members of the uniform blocks come from their buffers
+		GLuint index = i;
+		GLint block = -1;
+		glGetActiveUniformsiv(program->id, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+		if (block != -1) { continue; }
+
+		size_t u = 0;
+		for (; u < UNIFORM_COUNT && strcmp(name, uniform_names[u]); ++u);
+		if (u == UNIFORM_COUNT) {
+			fprintf(stderr, "ERROR:\tUniform [\"%s\"] has no entry in the uniform table!\n", name);
+			continue;
+		}
+		program->uniforms[u] = glGetUniformLocation(program->id, name);
+	}
+}
+static uint32_t compile_shader(GLenum type, const char* source, const char* file) {
+	uint32_t shader = glCreateShader(type);
+	int32_t len = cyx_str_length(source);
+	glShaderSource(shader, 1, (const char* const*)&source, &len);
+	glCompileShader(shader);
+	check_shader_compile_status(shader, file);
+	return shader;
+}
+
+// FNV-1a, the terminating zero goes in too so the parts can not run into each other
+static uint64_t program_hash(uint64_t hash, const char* str, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		hash = (hash ^ (uint8_t)str[i]) * 0x100000001b3;
+	}
+	return hash * 0x100000001b3;
+}
+#define PROGRAM_CACHE_MAGIC 0x4E494250 // "PBIN"
+// magic, binary format and length in front of the binary itself
+typedef struct {
+	uint32_t magic;
+	uint32_t format;
+	uint32_t length;
+} ProgramCacheHeader;
+
+// 0 if there is no binary or the driver does not take it anymore
+static int program_cache_load(Program* program, const char* path, int format_count) {
+	FILE* file = fopen(path, "rb");
+	if (!file) { return 0; }
+
+	// the length comes from the file, a broken one must not get more than the file holds allocated
+	struct stat st;
+	ProgramCacheHeader header = { 0 };
+	void* binary = NULL;
+	int ok = !fstat(fileno(file), &st) &&
+		fread(&header, sizeof(header), 1, file) == 1 && header.magic == PROGRAM_CACHE_MAGIC && header.length &&
+		(uint64_t)header.length == (uint64_t)st.st_size - sizeof(header);
+	if (ok) {
+		binary = malloc(header.length);
+		ok = binary && fread(binary, 1, header.length, file) == header.length;
+	}
+	fclose(file);
+	if (!ok) {
+		free(binary);
+		return 0;
+	}
+
+	// a format the driver does not list is not even passed to it
+	GLint* formats = malloc(format_count * sizeof(GLint));
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+	int known = 0;
+	for (int i = 0; i < format_count; ++i) {
+		known |= (GLenum)formats[i] == header.format;
+	}
+	free(formats);
+	if (!known) {
+		printf("LOG:\tProgram binary [\"%s\"] is in a format the driver does not take, compiling from source\n", path);
+		free(binary);
+		return 0;
+	}
+
+	program->id = glCreateProgram();
+	glProgramBinary(program->id, header.format, binary, header.length);
+	free(binary);
+	int linked = 0;
+	glGetProgramiv(program->id, GL_LINK_STATUS, &linked);
+	if (!linked) {
+		printf("LOG:\tProgram binary [\"%s\"] was rejected by the driver, compiling from source\n", path);
+		glDeleteProgram(program->id);
+		program->id = 0;
+		return 0;
+	}
+	return 1;
+}
+static void program_cache_store(const Program* program, const char* cache_dir, const char* path) {
+	int length = 0;
+	glGetProgramiv(program->id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) { return; }
+	if (mkdir(cache_dir, 0755) && errno != EEXIST) {
+		fprintf(stderr, "ERROR:\tUnable to create the program cache directory [\"%s\"]!\n", cache_dir);
+		return;
+	}
+
+	ProgramCacheHeader header = { .magic = PROGRAM_CACHE_MAGIC };
+	void* binary = malloc(length);
+	GLenum format = 0;
+	glGetProgramBinary(program->id, length, NULL, &format, binary);
+	header.format = format;
+	header.length = length;
+
+	// written next to it and renamed, a run that dies halfway never leaves a cut off binary behind
+	char tmp_path[512 + 8];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	FILE* file = fopen(tmp_path, "wb");
+	int ok = file &&
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(binary, 1, length, file) == (size_t)length;
+	if (file && fclose(file)) { ok = 0; }
+	if (!ok || rename(tmp_path, path)) {
+		fprintf(stderr, "ERROR:\tUnable to write the program binary [\"%s\"]!\n", path);
+		remove(tmp_path);
+	}
+	free(binary);
+}
+
+Program compile_program(EvoAllocator* alloc, const char* vert_file, const char* frag_file, const char* cache_dir) {
+	evo_temp_set_mark(alloc->ctx);
+	char* vert_source = cyx_str_from_file(alloc, vert_file);
+	char* frag_source = cyx_str_from_file(alloc, frag_file);
+
+	Program program = { 0 };
+	char cache_path[512] = { 0 };
+	int formats = 0;
+	if (cache_dir) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	if (formats > 0) {
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		const char* version = (const char*)glGetString(GL_VERSION);
+		uint64_t hash = 0xcbf29ce484222325;
+		hash = program_hash(hash, vert_source, cyx_str_length(vert_source));
+		hash = program_hash(hash, frag_source, cyx_str_length(frag_source));
+		hash = program_hash(hash, renderer, renderer ? strlen(renderer) : 0);
+		hash = program_hash(hash, version, version ? strlen(version) : 0);
+		snprintf(cache_path, sizeof(cache_path), "%s/program-%016llx.bin", cache_dir, (unsigned long long)hash);
+
+		program.from_cache = program_cache_load(&program, cache_path, formats);
+	}
+
+	if (!program.from_cache) {
+		uint32_t vert_shader = compile_shader(GL_VERTEX_SHADER, vert_source, vert_file);
+		uint32_t frag_shader = compile_shader(GL_FRAGMENT_SHADER, frag_source, frag_file);
+
+		program.id = glCreateProgram();
+		if (formats > 0) {
+			glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glAttachShader(program.id, vert_shader);
+		glAttachShader(program.id, frag_shader);
+		glLinkProgram(program.id);
+		check_program_compile_status(program.id);
+
+		glDeleteShader(vert_shader);
+		glDeleteShader(frag_shader);
+
+		int linked = 0;
+		glGetProgramiv(program.id, GL_LINK_STATUS, &linked);
+		if (formats > 0 && linked) {
+			program_cache_store(&program, cache_dir, cache_path);
+		}
+	}
+	evo_temp_reset_mark(alloc->ctx);
+
+	program_reflect(&program);
+	return program;
+}
+void program_free(Program* program) {
+	gl_delete_program(program->id);
+	program->id = 0;
+}
+
+static size_t gl_calls = 0;
+
+// the GLEW entry points are plain function pointers, so they get swapped for ones that count and forward
+#define GL_COUNTED_VOID(name, type, params, args) \
+	static type __counted_##name; \
+	static void GLAPIENTRY __counting_##name params { ++gl_calls; __counted_##name args; }
+#define GL_COUNTED(ret, name, type, params, args) \
+	static type __counted_##name; \
+	static ret GLAPIENTRY __counting_##name params { ++gl_calls; return __counted_##name args; }
+#define GL_COUNT_INSTALL(name) do { \
+	__counted_##name = __glew##name; \
+	__glew##name = __counting_##name; \
+} while (0)
+
+GL_COUNTED(GLint, GetUniformLocation, PFNGLGETUNIFORMLOCATIONPROC, (GLuint program, const GLchar* name), (program, name))
+GL_COUNTED_VOID(UseProgram, PFNGLUSEPROGRAMPROC, (GLuint program), (program))
+GL_COUNTED_VOID(Uniform1i, PFNGLUNIFORM1IPROC, (GLint location, GLint v0), (location, v0))
+GL_COUNTED_VOID(Uniform1f, PFNGLUNIFORM1FPROC, (GLint location, GLfloat v0), (location, v0))
+GL_COUNTED_VOID(Uniform2f, PFNGLUNIFORM2FPROC, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+GL_COUNTED_VOID(Uniform3f, PFNGLUNIFORM3FPROC, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+GL_COUNTED_VOID(Uniform4f, PFNGLUNIFORM4FPROC, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+GL_COUNTED_VOID(UniformMatrix4fv, PFNGLUNIFORMMATRIX4FVPROC, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value))
+GL_COUNTED_VOID(BindVertexArray, PFNGLBINDVERTEXARRAYPROC, (GLuint array), (array))
+GL_COUNTED_VOID(BindBuffer, PFNGLBINDBUFFERPROC, (GLenum target, GLuint buffer), (target, buffer))
+GL_COUNTED_VOID(BufferData, PFNGLBUFFERDATAPROC, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage))
+GL_COUNTED_VOID(BufferSubData, PFNGLBUFFERSUBDATAPROC, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data))
+GL_COUNTED_VOID(ActiveTexture, PFNGLACTIVETEXTUREPROC, (GLenum texture), (texture))
+GL_COUNTED_VOID(DrawArraysInstanced, PFNGLDRAWARRAYSINSTANCEDPROC, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount))
+GL_COUNTED_VOID(MultiDrawElements, PFNGLMULTIDRAWELEMENTSPROC, (GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei drawcount), (mode, count, type, indices, drawcount))
+
+void gl_count_calls(void) {
+	static int installed = 0;
+	if (installed) { return; }
+	installed = 1;
+
+	GL_COUNT_INSTALL(GetUniformLocation);
+	GL_COUNT_INSTALL(UseProgram);
+	GL_COUNT_INSTALL(Uniform1i);
+	GL_COUNT_INSTALL(Uniform1f);
+	GL_COUNT_INSTALL(Uniform2f);
+	GL_COUNT_INSTALL(Uniform3f);
+	GL_COUNT_INSTALL(Uniform4f);
+	GL_COUNT_INSTALL(UniformMatrix4fv);
+	GL_COUNT_INSTALL(BindVertexArray);
+	GL_COUNT_INSTALL(BindBuffer);
+	GL_COUNT_INSTALL(BufferData);
+	GL_COUNT_INSTALL(BufferSubData);
+	GL_COUNT_INSTALL(ActiveTexture);
+	GL_COUNT_INSTALL(DrawArraysInstanced);
+	GL_COUNT_INSTALL(MultiDrawElements);
+}
+size_t gl_call_count(void) {
+	return gl_calls + gl_state_core_calls();
+}
@@ -0,0 +1,440 @@
+#include <raster.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CYLIBX_ALLOC
+#include <cylibx.h>
+
+static void* raster_loop(void* arg) {
+	RasterThread* thread = arg;
+	Raster* raster = thread->raster;
+
+	uint32_t seen = 0;
+	pthread_mutex_lock(&raster->lock);
+	for (;;) {
+		while (raster->round == seen && !raster->quit) {
+			pthread_cond_wait(&raster->start, &raster->lock);
+		}
+		if (raster->quit) { break; }
+		seen = raster->round;
+
+		pthread_mutex_unlock(&raster->lock);
+		raster->task(raster, thread->index);
+		pthread_mutex_lock(&raster->lock);
+		if (--raster->running == 0) {
+			pthread_cond_signal(&raster->finished);
+		}
+	}
+	pthread_mutex_unlock(&raster->lock);
+	return NULL;
+}
+// runs `task` on every thread, the caller takes thread 0
+static void raster_dispatch(Raster* raster, RasterTask task) {
+	pthread_mutex_lock(&raster->lock);
+	raster->task = task;
+	raster->running = raster->thread_count;
+	raster->round++;
+	pthread_cond_broadcast(&raster->start);
+	pthread_mutex_unlock(&raster->lock);
+
+	task(raster, 0);
+
+	pthread_mutex_lock(&raster->lock);
+	while (raster->running) {
+		pthread_cond_wait(&raster->finished, &raster->lock);
+	}
+	pthread_mutex_unlock(&raster->lock);
+}
+
+static void raster_free_bins(Raster* raster, uint32_t first, uint32_t last) {
+	for (uint32_t t = first; t <= last; ++t) {
+		if (!raster->bins[t].bins) { continue; }
+		for (uint32_t i = 0; i < raster->tiles_x * raster->tiles_y; ++i) {
+			cyx_array_free(raster->bins[t].bins[i]);
+		}
+		free(raster->bins[t].bins);
+		cyx_array_free(raster->bins[t].triangles);
+		raster->bins[t] = (RasterBins){ 0 };
+	}
+}
+int raster_start(Raster* raster, uint32_t width, uint32_t height) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t thread_count = cpus > 1 ? (uint32_t)cpus - 1 : 0;
+	if (thread_count > RASTER_MAX_THREADS - 1) {
+		thread_count = RASTER_MAX_THREADS - 1;
+	}
+
+	*raster = (Raster){
+		.width = width,
+		.height = height,
+		.pixels = malloc((size_t)width * height * 4),
+		.depth = malloc((size_t)width * height * sizeof(float)),
+		.tiles_x = (width + RASTER_TILE - 1) / RASTER_TILE,
+		.tiles_y = (height + RASTER_TILE - 1) / RASTER_TILE,
+		.thread_count = thread_count,
+	};
+	uint32_t tiles = raster->tiles_x * raster->tiles_y;
+	int allocated = raster->pixels && raster->depth;
+	for (uint32_t t = 0; t <= thread_count && allocated; ++t) {
+		raster->bins[t].bins = malloc(tiles * sizeof(uint32_t*));
+		if (!raster->bins[t].bins) { allocated = 0; break; }
+		raster->bins[t].triangles = cyx_array_new(RasterTriangle, NULL);
+		for (uint32_t i = 0; i < tiles; ++i) {
+			raster->bins[t].bins[i] = cyx_array_new(uint32_t, NULL);
+		}
+	}
+	if (!allocated) {
+		fprintf(stderr, "ERROR:\tUnable to allocate a %ux%u raster!\n", width, height);
+		raster_free_bins(raster, 0, thread_count);
+		free(raster->pixels);
+		free(raster->depth);
+		return 0;
+	}
+
+	pthread_mutex_init(&raster->lock, NULL);
+	pthread_cond_init(&raster->start, NULL);
+	pthread_cond_init(&raster->finished, NULL);
+	for (uint32_t i = 0; i < thread_count; ++i) {
+		raster->threads[i] = (RasterThread){ .raster = raster, .index = i + 1 };
+		if (pthread_create(&raster->threads[i].thread, NULL, raster_loop, &raster->threads[i])) {
+			// the threads that did start are enough, the work is split between them and the caller
+			raster->thread_count = i;
+			raster_free_bins(raster, i + 1, thread_count);
+			break;
+		}
+	}
+	return 1;
+}
+void raster_clear(Raster* raster, Color color) {
+	size_t count = (size_t)raster->width * raster->height;
+	for (size_t i = 0; i < count; ++i) {
+		memcpy(raster->pixels + 4 * i, &color, 4);
+		raster->depth[i] = 1.f;
+	}
+}
+
+static inline uint8_t raster_unorm(float x) {
+	return x <= 0.f ? 0 : x >= 1.f ? 255 : (uint8_t)(x * 255.f + 0.5f);
+}
+static inline void raster_mult_vec(const Mat4* m, const float* v, float w, float* out, size_t rows) {
+	for (size_t i = 0; i < rows; ++i) {
+		out[i] = m->data[i] * v[0] + m->data[i + 4] * v[1] + m->data[i + 8] * v[2] + m->data[i + 12] * w;
+	}
+}
+// the part of [0, count) thread `thread` gets
+static inline void raster_split(const Raster* raster, uint32_t thread, size_t count, size_t* begin, size_t* end) {
+	size_t parts = raster->thread_count + 1;
+	*begin = count * thread / parts;
+	*end = count * (thread + 1) / parts;
+}
+
+static void raster_transform_task(Raster* raster, uint32_t thread) {
+	size_t begin, end;
+	raster_split(raster, thread, raster->vertex_count, &begin, &end);
+	for (size_t v = begin; v < end; ++v) {
+		const float* in = raster->vertices + v * MESH_VERTEX_FLOATS;
+		float* out = raster->transformed + v * RASTER_VERTEX_FLOATS;
+		raster_mult_vec(&raster->clip, in, 1.f, out, 4);
+		raster_mult_vec(&raster->model, in, 1.f, out + 4, 3);
+		raster_mult_vec(&raster->normal, in + 3, 0.f, out + 7, 3);
+	}
+}
+
+// sets up one triangle that lies in front of the near plane and bins it
+static void raster_setup(Raster* raster, RasterBins* bins, const float* corners[3], Color color) {
+	const Shape3D* shape = raster->shape;
+	float x[3], y[3], z[3], inv_w[3];
+	for (size_t i = 0; i < 3; ++i) {
+		inv_w[i] = 1.f / corners[i][3];
+		x[i] = raster->view_x + (0.5f + 0.5f * corners[i][0] * inv_w[i]) * raster->view_w;
+		y[i] = raster->view_y + (0.5f - 0.5f * corners[i][1] * inv_w[i]) * raster->view_h;
+		z[i] = 0.5f + 0.5f * corners[i][2] * inv_w[i];
+	}
+
+	// y goes down the target, so the counter clockwise front faces of GL come out clockwise here
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0 || !isfinite(area) || (shape->face_cull && area > 0)) { return; }
+
+	RasterTriangle tri = { .color = color };
+	float min_x = x[0], max_x = x[0], min_y = y[0], max_y = y[0];
+	for (size_t i = 0; i < 3; ++i) {
+		// the edge opposite corner i, from corner j to corner k
+		size_t j = (i + 1) % 3, k = (i + 2) % 3;
+		float a = -(y[k] - y[j]), b = x[k] - x[j];
+		tri.a[i] = a / area;
+		tri.b[i] = b / area;
+		tri.c[i] = -(a * x[j] + b * y[j]) / area;
+		tri.top_left[i] = tri.a[i] > 0 || (tri.a[i] == 0 && tri.b[i] > 0) ? -1 : 0;
+
+		tri.depth[i] = z[i];
+		tri.inv_w[i] = inv_w[i];
+		for (size_t c = 0; c < 3; ++c) {
+			tri.world[i][c] = corners[i][4 + c] * inv_w[i];
+			tri.normal[i][c] = corners[i][7 + c] * inv_w[i];
+		}
+		min_x = fminf(min_x, x[i]); max_x = fmaxf(max_x, x[i]);
+		min_y = fminf(min_y, y[i]); max_y = fmaxf(max_y, y[i]);
+	}
+
+	// pixels whose centres can be inside, clamped to the viewport and the target
+	int32_t view_max_x = raster->view_x + raster->view_w - 1, view_max_y = raster->view_y + raster->view_h - 1;
+	if (view_max_x > (int32_t)raster->width - 1) { view_max_x = raster->width - 1; }
+	if (view_max_y > (int32_t)raster->height - 1) { view_max_y = raster->height - 1; }
+	tri.min_x = fmaxf(floorf(min_x - 0.5f), fmaxf(raster->view_x, 0));
+	tri.min_y = fmaxf(floorf(min_y - 0.5f), fmaxf(raster->view_y, 0));
+	tri.max_x = fminf(ceilf(max_x - 0.5f), view_max_x);
+	tri.max_y = fminf(ceilf(max_y - 0.5f), view_max_y);
+	if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) { return; }
+
+	uint32_t id = cyx_array_length(bins->triangles);
+	cyx_array_append(bins->triangles, tri);
+	for (int32_t ty = tri.min_y / RASTER_TILE; ty <= tri.max_y / RASTER_TILE; ++ty) {
+		for (int32_t tx = tri.min_x / RASTER_TILE; tx <= tri.max_x / RASTER_TILE; ++tx) {
+			cyx_array_append(bins->bins[ty * raster->tiles_x + tx], id);
+		}
+	}
+}
+// a triangle crossing the near plane (z = -w in clip space) gets cut down to the part in front of it, one or two triangles
+static void raster_clip(Raster* raster, RasterBins* bins, const float* corners[3], Color color) {
+	float distance[3];
+	int inside = 0;
+	for (size_t i = 0; i < 3; ++i) {
+		distance[i] = corners[i][2] + corners[i][3];
+		inside += distance[i] >= 0;
+	}
+	if (inside == 3) {
+		raster_setup(raster, bins, corners, color);
+		return;
+	}
+	if (!inside) { return; }
+
+	float polygon[4][RASTER_VERTEX_FLOATS];
+	size_t count = 0;
+	for (size_t i = 0; i < 3; ++i) {
+		size_t j = (i + 1) % 3;
+		if (distance[i] >= 0) {
+			memcpy(polygon[count++], corners[i], sizeof(polygon[0]));
+		}
+		if ((distance[i] >= 0) != (distance[j] >= 0)) {
+			float t = distance[i] / (distance[i] - distance[j]);
+			for (size_t f = 0; f < RASTER_VERTEX_FLOATS; ++f) {
+				polygon[count][f] = corners[i][f] + t * (corners[j][f] - corners[i][f]);
+			}
+			++count;
+		}
+	}
+	for (size_t i = 1; i + 1 < count; ++i) {
+		const float* fan[3] = { polygon[0], polygon[i], polygon[i + 1] };
+		raster_setup(raster, bins, fan, color);
+	}
+}
+static void raster_setup_task(Raster* raster, uint32_t thread) {
+	RasterBins* bins = &raster->bins[thread];
+	cyx_array_clear(bins->triangles);
+	for (uint32_t i = 0; i < raster->tiles_x * raster->tiles_y; ++i) {
+		cyx_array_clear(bins->bins[i]);
+	}
+
+	const Shape3D* shape = raster->shape;
+	uint32_t whole = raster->index_count;
+	uint32_t range_count = shape->range_count > 1 ? shape->range_count : 1;
+	const uint32_t* range_ends = shape->range_count > 1 ? shape->range_ends : &whole;
+
+	size_t begin, end;
+	raster_split(raster, thread, raster->index_count / 3, &begin, &end);
+	uint32_t range = 0;
+	for (size_t t = begin; t < end; ++t) {
+		while (range + 1 < range_count && 3 * t >= range_ends[range]) { ++range; }
+		const float* corners[3];
+		for (size_t i = 0; i < 3; ++i) {
+			corners[i] = raster->transformed + (size_t)raster->indices[3 * t + i] * RASTER_VERTEX_FLOATS;
+		}
+		raster_clip(raster, bins, corners, shape3d_range_color(shape->color, range));
+	}
+}
+
+// the phong model of shader3d.frag
+static void raster_shade(const Shape3D* shape, const float* world, const float* normal, Color color, uint8_t* out) {
+	float light_color[4] = { COLOR_UNPACK_F(shape->light_color) };
+	float n_len = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	float light_pos[3] = { shape->light_pos.x, shape->light_pos.y, shape->light_pos.z };
+	float view_pos[3] = { shape->camera.x, shape->camera.y, shape->camera.z };
+
+	float n[3], l[3], v[3];
+	float l_len = 0, v_len = 0;
+	for (size_t i = 0; i < 3; ++i) {
+		n[i] = normal[i] / n_len;
+		l[i] = light_pos[i] - world[i];
+		v[i] = view_pos[i] - world[i];
+		l_len += l[i] * l[i];
+		v_len += v[i] * v[i];
+	}
+	l_len = sqrtf(l_len);
+	v_len = sqrtf(v_len);
+	float n_dot_l = 0, v_dot_r = 0;
+	for (size_t i = 0; i < 3; ++i) {
+		l[i] /= l_len;
+		v[i] /= v_len;
+		n_dot_l += n[i] * l[i];
+	}
+	for (size_t i = 0; i < 3; ++i) {
+		v_dot_r += v[i] * (2 * n_dot_l * n[i] - l[i]);
+	}
+	float light = 0.2f + fmaxf(n_dot_l, 0.f) + shape->reflectivity * powf(fmaxf(v_dot_r, 0.f), shape->shininess);
+
+	float rgba[4] = { COLOR_UNPACK_F(color) };
+	for (size_t i = 0; i < 3; ++i) {
+		out[i] = raster_unorm(light * light_color[i] * rgba[i]);
+	}
+	out[3] = 255;
+}
+static void raster_triangle(Raster* raster, const RasterTriangle* tri, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+	const Shape3D* shape = raster->shape;
+	RasterLanes offsets;
+	for (int32_t i = 0; i < RASTER_LANES; ++i) { offsets[i] = i + 0.5f; }
+
+	for (int32_t y = y0; y <= y1; ++y) {
+		float py = y + 0.5f;
+		float row[3];
+		for (size_t i = 0; i < 3; ++i) { row[i] = tri->b[i] * py + tri->c[i]; }
+
+		for (int32_t x = x0; x <= x1; x += RASTER_LANES) {
+			RasterLanes px = offsets + (float)x;
+			RasterMask mask = px < (float)(x1 + 1);
+			RasterLanes l[3];
+			for (size_t i = 0; i < 3; ++i) {
+				l[i] = tri->a[i] * px + row[i];
+				mask &= (l[i] > 0) | ((l[i] == 0) & tri->top_left[i]);
+			}
+			int any = 0;
+			for (int32_t i = 0; i < RASTER_LANES; ++i) { any |= mask[i]; }
+			if (!any) { continue; }
+
+			float* depth_row = raster->depth + (size_t)y * raster->width + x;
+			RasterLanes z = l[0] * tri->depth[0] + l[1] * tri->depth[1] + l[2] * tri->depth[2];
+			if (shape->depth_test) {
+				RasterLanes stored;
+				for (int32_t i = 0; i < RASTER_LANES; ++i) { stored[i] = mask[i] ? depth_row[i] : 0.f; }
+				mask &= z < stored;
+			}
+
+			for (int32_t i = 0; i < RASTER_LANES; ++i) {
+				if (!mask[i]) { continue; }
+				float w = 1.f / (l[0][i] * tri->inv_w[0] + l[1][i] * tri->inv_w[1] + l[2][i] * tri->inv_w[2]);
+				float world[3], normal[3];
+				for (size_t c = 0; c < 3; ++c) {
+					world[c] = (l[0][i] * tri->world[0][c] + l[1][i] * tri->world[1][c] + l[2][i] * tri->world[2][c]) * w;
+					normal[c] = (l[0][i] * tri->normal[0][c] + l[1][i] * tri->normal[1][c] + l[2][i] * tri->normal[2][c]) * w;
+				}
+				raster_shade(shape, world, normal, tri->color, raster->pixels + 4 * ((size_t)y * raster->width + x + i));
+				if (shape->depth_test) {
+					depth_row[i] = z[i];
+				}
+			}
+		}
+	}
+}
+static void raster_tile_task(Raster* raster, uint32_t thread) {
+	(void)thread;
+	uint32_t tiles = raster->tiles_x * raster->tiles_y;
+	for (uint32_t tile = atomic_fetch_add(&raster->next_tile, 1); tile < tiles; tile = atomic_fetch_add(&raster->next_tile, 1)) {
+		int32_t tile_x = (tile % raster->tiles_x) * RASTER_TILE, tile_y = (tile / raster->tiles_x) * RASTER_TILE;
+		// the bins of the threads hold consecutive parts of the mesh, so going over them in order keeps the draw order
+		for (uint32_t t = 0; t <= raster->thread_count; ++t) {
+			const RasterBins* bins = &raster->bins[t];
+			const uint32_t* bin = bins->bins[tile];
+			for (size_t i = 0; i < cyx_array_length(bin); ++i) {
+				const RasterTriangle* tri = &bins->triangles[bin[i]];
+				int32_t x0 = tri->min_x > tile_x ? tri->min_x : tile_x;
+				int32_t y0 = tri->min_y > tile_y ? tri->min_y : tile_y;
+				int32_t x1 = tri->max_x < tile_x + RASTER_TILE - 1 ? tri->max_x : tile_x + RASTER_TILE - 1;
+				int32_t y1 = tri->max_y < tile_y + RASTER_TILE - 1 ? tri->max_y : tile_y + RASTER_TILE - 1;
+				raster_triangle(raster, tri, x0, y0, x1, y1);
+			}
+		}
+	}
+}
+
+void raster_shape3d(Raster* raster, const Shape3D* shape, const uint32_t* indices, size_t index_count, const float* vertices, uint32_t vertex_count, int x, int y, int w, int h) {
+	if (!index_count || w <= 0 || h <= 0) { return; }
+
+	size_t size = (size_t)vertex_count * RASTER_VERTEX_FLOATS;
+	if (size > raster->transformed_capacity) {
+		free(raster->transformed);
+		raster->transformed = malloc(size * sizeof(float));
+		raster->transformed_capacity = size;
+	}
+
+	raster->shape = shape;
+	raster->indices = indices;
+	raster->index_count = index_count;
+	raster->vertices = vertices;
+	raster->vertex_count = vertex_count;
+	raster->view_x = x;
+	raster->view_y = y;
+	raster->view_w = w;
+	raster->view_h = h;
+
+	// the same matrices as shape3d_show
+	raster->model = mat4_model(shape->pos, 0, vec4(0, 1, 0), vec4(1.f/shape->scale, 1.f/shape->scale, 1.f/shape->scale));
+	raster->normal = mat4_normal(raster->model);
+	Mat4 proj = mat4_perspective(SHAPE3D_FOV, (float)w / h, SHAPE3D_NEAR, SHAPE3D_FAR);
+	Mat4 view = mat4_look_at(shape->camera, vec4(0, 0, 0), vec4(0, 1, 0));
+	raster->clip = mat4_mult(proj, mat4_mult(view, raster->model));
+
+	raster_dispatch(raster, raster_transform_task);
+	raster_dispatch(raster, raster_setup_task);
+	atomic_store(&raster->next_tile, 0);
+	raster_dispatch(raster, raster_tile_task);
+}
+// the fill and border of rect_batch.frag, blended over what is there like the GL blend function
+void raster_rect(Raster* raster, const Rectangle* rect, int x, int y, int w, int h) {
+	if (w <= 0 || h <= 0) { return; }
+	float border_x = rect->border_width > 0 ? rect->border_width * 2.f / w : 0;
+	float border_y = rect->border_width > 0 ? rect->border_width * 2.f / h : 0;
+	float fill[4] = { COLOR_UNPACK_F(rect->color) };
+	float border[4] = { COLOR_UNPACK_F(rect->border_color) };
+
+	int x0 = x > 0 ? x : 0, y0 = y > 0 ? y : 0;
+	int x1 = x + w < (int)raster->width ? x + w : (int)raster->width;
+	int y1 = y + h < (int)raster->height ? y + h : (int)raster->height;
+	for (int py = y0; py < y1; ++py) {
+		float v_y = 2.f * (py + 0.5f - y) / h - 1.f;
+		for (int px = x0; px < x1; ++px) {
+			float v_x = 2.f * (px + 0.5f - x) / w - 1.f;
+			int inner = !(border_x > 0) || !(border_y > 0) ||
+				(v_x > -1.f + border_x && v_x < 1.f - border_x && v_y > -1.f + border_y && v_y < 1.f - border_y);
+			const float* src = inner ? fill : border;
+
+			uint8_t* dst = raster->pixels + 4 * ((size_t)py * raster->width + px);
+			for (size_t i = 0; i < 4; ++i) {
+				dst[i] = raster_unorm(src[i] * src[3] + dst[i] / 255.f * (1.f - src[3]));
+			}
+		}
+	}
+}
+
+int raster_write_png(const Raster* raster, const char* path) {
+	return png_write(path, raster->width, raster->height, raster->pixels, 0);
+}
+
+void raster_stop(Raster* raster) {
+	pthread_mutex_lock(&raster->lock);
+	raster->quit = 1;
+	pthread_cond_broadcast(&raster->start);
+	pthread_mutex_unlock(&raster->lock);
+	for (uint32_t i = 0; i < raster->thread_count; ++i) {
+		pthread_join(raster->threads[i].thread, NULL);
+	}
+	raster_free_bins(raster, 0, raster->thread_count);
+	free(raster->pixels);
+	free(raster->depth);
+	free(raster->transformed);
+	pthread_mutex_destroy(&raster->lock);
+	pthread_cond_destroy(&raster->start);
+	pthread_cond_destroy(&raster->finished);
+}
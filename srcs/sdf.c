@@ -0,0 +1,105 @@
+#include <sdf.h>
+
+#include <math.h>
+#include <assert.h>
+
+#define CYLIBX_ALLOC
+#include <cylibx.h>
+
+// the quadratic curves get flattened into lines about this many pixels long
+#define SDF_FLATTEN_PIXELS 2.f
+
+typedef struct {
+	float x0, y0, x1, y1;
+} SdfSegment;
+
+static void sdf_append_curve(SdfSegment** segments, Point p0, Point c, Point p1, float scale) {
+	// the curve never strays further from its control polygon than the polygon is long
+	float length = (hypotf(c.x - p0.x, c.y - p0.y) + hypotf(p1.x - c.x, p1.y - c.y)) * scale;
+	int steps = 1 + (int)(length / SDF_FLATTEN_PIXELS);
+	if (c.on_curve) { steps = 1; }
+
+	float px = p0.x, py = p0.y;
+	for (int i = 1; i <= steps; ++i) {
+		float t = (float)i / steps;
+		float u = 1.f - t;
+		float x = u * u * p0.x + 2.f * u * t * c.x + t * t * p1.x;
+		float y = u * u * p0.y + 2.f * u * t * c.y + t * t * p1.y;
+		cyx_array_append(*segments, ((SdfSegment){ px, py, x, y }));
+		px = x;
+		py = y;
+	}
+}
+// the outline as lines in font units, consecutive points of the same kind have an implied point between them
+static SdfSegment* sdf_glyph_segments(EvoAllocator* alloc, const GlyphData* glyph, float scale) {
+	SdfSegment* segments = cyx_array_new(SdfSegment, alloc);
+	Point* points = cyx_array_new(Point, alloc);
+
+	size_t prev = 0;
+	for (size_t i = 0; i < cyx_array_length(glyph->contour_end_indicies); ++i) {
+		size_t end = glyph->contour_end_indicies[i];
+		cyx_array_clear(points);
+		for (size_t j = prev; j <= end; ++j) {
+			Point p1 = glyph->points[j];
+			Point p2 = glyph->points[j < end ? j + 1 : prev];
+			cyx_array_append(points, p1);
+			if (p1.on_curve == p2.on_curve) {
+				cyx_array_append(points, ((Point){ .x = (p1.x + p2.x) / 2, .y = (p1.y + p2.y) / 2, .on_curve = !p1.on_curve }));
+			}
+		}
+		prev = end + 1;
+
+		// the points now alternate, so starting on a point on the curve every odd one is a control point
+		size_t n = cyx_array_length(points);
+		if (n < 2) { continue; }
+		size_t first = points[0].on_curve ? 0 : 1;
+		for (size_t j = 0; j < n; j += 2) {
+			sdf_append_curve(&segments, points[(first + j) % n], points[(first + j + 1) % n], points[(first + j + 2) % n], scale);
+		}
+	}
+	return segments;
+}
+
+void sdf_glyph_size(const GlyphData* glyph, SdfParams params, int* w, int* h) {
+	*w = (int)ceilf((glyph->max_x - glyph->min_x) * params.scale) + 2 * params.spread;
+	*h = (int)ceilf((glyph->max_y - glyph->min_y) * params.scale) + 2 * params.spread;
+}
+void sdf_render_glyph(const GlyphData* glyph, SdfParams params, uint8_t* pixels, size_t stride, int w, int h) {
+	EvoAllocator temp = evo_allocator_arena_heap(EVO_KB(16));
+	SdfSegment* segments = sdf_glyph_segments(&temp, glyph, params.scale);
+	size_t count = cyx_array_length(segments);
+
+	for (int row = 0; row < h; ++row) {
+		// texel centers in font units, the rows go down from the top of the box
+		float y = glyph->max_y - (row + 0.5f - params.spread) / params.scale;
+		for (int col = 0; col < w; ++col) {
+			float x = glyph->min_x + (col + 0.5f - params.spread) / params.scale;
+
+			float min_distance = INFINITY;
+			int winding = 0;
+			for (size_t s = 0; s < count; ++s) {
+				const SdfSegment* seg = &segments[s];
+				float dx = seg->x1 - seg->x0, dy = seg->y1 - seg->y0;
+				float length = dx * dx + dy * dy;
+				float t = length > 0 ? ((x - seg->x0) * dx + (y - seg->y0) * dy) / length : 0;
+				t = t < 0 ? 0 : t > 1 ? 1 : t;
+				float ex = seg->x0 + t * dx - x, ey = seg->y0 + t * dy - y;
+				float distance = ex * ex + ey * ey;
+				if (distance < min_distance) { min_distance = distance; }
+
+				// non-zero winding, a line counts once whichever way it crosses the row
+				if ((seg->y0 <= y) != (seg->y1 <= y)) {
+					float cross = dx * (y - seg->y0) - (x - seg->x0) * dy;
+					winding += seg->y1 > seg->y0 ? (cross > 0) : -(cross < 0);
+				}
+			}
+
+			float distance = sqrtf(min_distance) * params.scale;
+			if (!winding) { distance = -distance; }
+			float value = 127.5f + distance * 127.5f / params.spread;
+			pixels[row * stride + col] = value < 0 ? 0 : value > 255 ? 255 : (uint8_t)value;
+		}
+	}
+
+	evo_allocator_free(&temp);
+}
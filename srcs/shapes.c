@@ -1,3 +1,5 @@
+#include <math.h>
+
 #include <color.h>
 #include <vec2.h>
 #include <mat.h>
@@ -7,54 +9,67 @@
 #define CYLIBX_ALLOC
 #include <cylibx.h>
 
-Rectangle __rect_create(struct __RectangleCreateParams params) {
-	Rectangle rect = {
-		.program = params.__program,
-		.color = params.__color,
-
-		.border_color = params.border_color,
-		.border_width = params.border_width,
+RectBatch rect_batch_create(const Program* program) {
+	RectBatch batch = {
+		.program = program,
+		.instances = cyx_array_new(float, NULL),
 	};
 
+	// a quad over [-1, 1], as a strip
 	float vertices[] = {
 		-1.0f,  1.0f,
 		-1.0f, -1.0f,
-		 1.0f, -1.0f,
 		 1.0f,  1.0f,
+		 1.0f, -1.0f,
 	};
 
-	uint32_t triangles[] = {
-		0, 1, 2,
-		0, 2, 3
-	};
-
-	glGenVertexArrays(1, &rect.vao);
-	glBindVertexArray(rect.vao);
+	glGenVertexArrays(1, &batch.vao);
+	gl_bind_vertex_array(batch.vao);
 
-	glGenBuffers(1, &rect.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, rect.vbo);
+	glGenBuffers(1, &batch.quad_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.quad_vbo);
 	glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float), vertices, GL_STATIC_DRAW);
-
-	glGenBuffers(1, &rect.ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint32_t), triangles, GL_STATIC_DRAW);
-
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
 	glEnableVertexAttribArray(0);
 
-	return rect;
+	glGenBuffers(1, &batch.instance_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, batch.instance_vbo);
+	size_t stride = RECT_INSTANCE_FLOATS * sizeof(float);
+	// rect, colour, border colour, border
+	size_t sizes[] = { 4, 4, 4, 2 };
+	size_t offset = 0;
+	for (size_t i = 0; i < 4; ++i) {
+		glVertexAttribPointer(i + 1, sizes[i], GL_FLOAT, GL_FALSE, stride, (void*)(offset * sizeof(float)));
+		glVertexAttribDivisor(i + 1, 1);
+		glEnableVertexAttribArray(i + 1);
+		offset += sizes[i];
+	}
+	gl_bind_vertex_array(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return batch;
 }
-void rect_show(Rectangle* rect, int x, int y, int w, int h, int screen_w, int screen_h) {
-	glDisable(GL_DEPTH_TEST);
-	glUseProgram(rect->program);
+void rect_batch_push(RectBatch* batch, const Rectangle* rect, int x, int y, int w, int h) {
+	float border_x = 0, border_y = 0;
+	if (rect->border_width > 0) {
+		border_x = rect->border_width * 2.f / w;
+		border_y = rect->border_width * 2.f / h;
+	}
+	cyx_array_append_mult(batch->instances,
+		x, y, w, h,
+		COLOR_UNPACK_F(rect->color),
+		COLOR_UNPACK_F(rect->border_color),
+		border_x, border_y,
+	);
+}
+void rect_batch_flush(RectBatch* batch, int screen_w, int screen_h) {
+	size_t count = cyx_array_length(batch->instances) / RECT_INSTANCE_FLOATS;
+	if (!count) { return; }
 
-	// int uniform_scaling = glGetUniformLocation(rect->program, "u_scale"); 
-	// int uniform_translation = glGetUniformLocation(rect->program, "u_translate"); 
-	int uniform_projection = glGetUniformLocation(rect->program, "u_proj"); 
-	int uniform_model = glGetUniformLocation(rect->program, "u_model");
-	int uniform_color = glGetUniformLocation(rect->program, "u_color");
-	int uniform_border = glGetUniformLocation(rect->program, "u_border");
-	int uniform_border_color = glGetUniformLocation(rect->program, "u_border_color");
+	gl_set_cap(GL_STATE_DEPTH_TEST, 0);
+	gl_set_cap(GL_STATE_CULL_FACE, 0);
+	gl_viewport(0, 0, screen_w, screen_h);
+	gl_use_program(batch->program->id);
 
 	float proj[16] = { 
 		[0]  = 2.0f / screen_w, // 2 / (right - left)
@@ -62,127 +77,358 @@ void rect_show(Rectangle* rect, int x, int y, int w, int h, int screen_w, int sc
 		[10] = -1.0f, // -2 / (far - near)
 		[12] = -1.0f, // -(right + left) / (right - left)
 		[13] = 1.0f, // -(top + bottom) / (top - bottom)
-		// [14] = 0.0f, // -(far + near) / (far - near)
 		[15] = 1.0f, // 1
 	};
-	glUniformMatrix4fv(uniform_projection, 1, GL_FALSE, proj);
-
-	float model[16] = {
-		[0]  = w / 2.f,
-		[5]  = h / 2.f,
-		[10] = 1.f,
-		[12] = x + w / 2.f,
-		[13] = y + h / 2.f,
-		[15] = 1.f,
-	};
-	glUniformMatrix4fv(uniform_model, 1, GL_FALSE, model);
+	glUniformMatrix4fv(batch->program->uniforms[UNIFORM_PROJ], 1, GL_FALSE, proj);
 
-	glUniform4f(uniform_color, COLOR_UNPACK_F(rect->color));
-
-	if (rect->border_width > 0) {
-		glUniform4f(uniform_border_color, COLOR_UNPACK_F(rect->border_color));
-		glUniform2f(uniform_border, rect->border_width * 2.f / w, rect->border_width * 2.f / h);
-	} else {
-		glUniform2f(uniform_border, 0, 0);
+	// orphaned like the text stream, so the upload never waits on the previous draw
+	size_t size = cyx_array_length(batch->instances) * sizeof(float);
+	glBindBuffer(GL_ARRAY_BUFFER, batch->instance_vbo);
+	if (size > batch->instance_capacity) {
+		batch->instance_capacity = size * 2;
 	}
+	glBufferData(GL_ARRAY_BUFFER, batch->instance_capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, batch->instances);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	glBindVertexArray(rect->vao);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	gl_bind_vertex_array(batch->vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+	cyx_array_clear(batch->instances);
+}
+void rect_batch_free(RectBatch* batch) {
+	gl_delete_vertex_arrays(1, &batch->vao);
+	glDeleteBuffers(1, &batch->quad_vbo);
+	glDeleteBuffers(1, &batch->instance_vbo);
+	cyx_array_free(batch->instances);
+}
 
-	glBindVertexArray(0);
-	glUseProgram(0);
-	glEnable(GL_DEPTH_TEST);
+CameraBlock camera_block_create(void) {
+	CameraBlock block = { 0 };
+	glGenBuffers(1, &block.ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, block.ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlockData), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_CAMERA, block.ubo);
+	return block;
 }
-void rect_free(Rectangle* rect) {
-	glDeleteVertexArrays(1, &rect->vao);
-	glDeleteBuffers(1, &rect->vbo);
-	glDeleteBuffers(1, &rect->ebo);
+void camera_block_set(CameraBlock* block, const CameraBlockData* data) {
+	if (block->filled && !memcmp(&block->data, data, sizeof(*data))) { return; }
+	block->data = *data;
+	block->filled = 1;
+	glBindBuffer(GL_UNIFORM_BUFFER, block->ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(*data), data);
+}
+void camera_block_free(CameraBlock* block) {
+	glDeleteBuffers(1, &block->ubo);
 }
 
-Shape3D shape3d_create(uint32_t program, Color color, float scale, uint32_t* indices, float* triangle_coords) {
+Shape3D shape3d_create(const Program* program, CameraBlock* camera_block, Color color, float scale, uint32_t* indices, float* triangle_coords) {
 	assert(scale > 0);
 	Shape3D ret = {
 		.color = color,
 
 		.program = program,
-		.indicies_count = cyx_array_length(indices),
+		.camera_block = camera_block,
 		.scale = scale,
 	};
-	glGenVertexArrays(1, &ret.vao);
-	glBindVertexArray(ret.vao);
+	glGenVertexArrays(2, ret.vao);
+	glGenBuffers(2, ret.vbo);
+	glGenBuffers(2, ret.ebo);
+	for (size_t i = 0; i < 2; ++i) {
+		gl_bind_vertex_array(ret.vao[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, ret.vbo[i]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ret.ebo[i]);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), NULL);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+	}
+	gl_bind_vertex_array(0);
 
-	glGenBuffers(1, &ret.vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, ret.vbo);
-	glBufferData(GL_ARRAY_BUFFER, cyx_array_length(triangle_coords) * sizeof(float), triangle_coords, GL_STATIC_DRAW);
+	// the first upload flips `front` onto the set that got filled
+	ret.front = 1;
+	shape3d_update(&ret, indices, triangle_coords);
+	return ret;
+}
+// writes `size` bytes into the buffer bound to `target`, the old contents are invalidated so the driver
+// can hand out fresh memory instead of waiting for frames still drawing from it
+static void shape3d_upload(GLenum target, size_t* capacity, const void* data, size_t size) {
+	if (size > *capacity) {
+		// the first upload is exact, later growth doubles so a mesh that keeps growing is not reallocated every time
+		*capacity = size > *capacity * 2 ? size : *capacity * 2;
+		glBufferData(target, *capacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (!size) { return; }
 
-	glGenBuffers(1, &ret.ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ret.ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, cyx_array_length(indices) * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+	void* mapped = glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped) {
+		memcpy(mapped, data, size);
+		if (glUnmapBuffer(target)) { return; }
+	}
+	// the mapping failed or its contents got lost
+	glBufferSubData(target, 0, size, data);
+}
+void shape3d_update(Shape3D* shape, uint32_t* indices, float* triangle_coords) {
+	uint8_t back = !shape->front;
+
+	gl_bind_vertex_array(shape->vao[back]);
+	glBindBuffer(GL_ARRAY_BUFFER, shape->vbo[back]);
+	shape3d_upload(GL_ARRAY_BUFFER, &shape->vbo_capacity[back], triangle_coords, cyx_array_length(triangle_coords) * sizeof(float));
+	shape3d_upload(GL_ELEMENT_ARRAY_BUFFER, &shape->ebo_capacity[back], indices, cyx_array_length(indices) * sizeof(uint32_t));
+	gl_bind_vertex_array(0);
+
+	shape->indicies_count[back] = cyx_array_length(indices);
+	shape->front = back;
+	shape->range_count = 0;
+	if (shape->meshlets) {
+		cyx_array_clear(shape->meshlets);
+	}
+}
+void shape3d_set_ranges(Shape3D* shape, uint32_t range_count, const uint32_t* range_ends) {
+	assert(range_count <= SHAPE3D_MAX_RANGES);
+	memcpy(shape->range_ends, range_ends, range_count * sizeof(uint32_t));
+	shape->range_count = range_count;
+}
+Color shape3d_range_color(Color color, uint32_t range) {
+	if (!range) { return color; }
+	// the palette without the colour of the shape itself, so neighbouring ranges never look the same
+	static const Color palette[] = { COLOR_ORANGE, COLOR_LIGHT_BLUE, COLOR_LIME, COLOR_PURPLE, COLOR_YELLOW, COLOR_PINK, COLOR_BLUE, COLOR_RED };
+	Color others[sizeof(palette) / sizeof(*palette)];
+	size_t count = 0;
+	for (size_t i = 0; i < sizeof(palette) / sizeof(*palette); ++i) {
+		if (memcmp(&palette[i], &color, sizeof(Color))) { others[count++] = palette[i]; }
+	}
+	return others[(range - 1) % count];
+}
+void shape3d_set_meshlets(Shape3D* shape, const Meshlet* meshlets, size_t count) {
+	if (!shape->meshlets) {
+		shape->meshlets = cyx_array_new(Meshlet, NULL);
+		shape->draw_counts = cyx_array_new(GLsizei, NULL);
+		shape->draw_offsets = cyx_array_new(void*, NULL);
+	}
+	cyx_array_clear(shape->meshlets);
+	cyx_array_append_mult_n(shape->meshlets, count, meshlets);
+}
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), NULL);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+typedef struct {
+	// side planes of the view in the space of the mesh, normalized so they give distances
+	float planes[4][4];
+	float camera[3];
+	uint8_t backface : 1;
+} MeshletCull;
+
+static MeshletCull meshlet_cull_setup(Shape3D* shape, Mat4 model, Mat4 view, Mat4 proj) {
+	MeshletCull cull = { .backface = shape->face_cull };
+	Mat4 clip = mat4_mult(proj, mat4_mult(view, model));
+	// w + x, w - x, w + y, w - y of clip space, the near and far planes never cut into the meshes
+	for (size_t p = 0; p < 4; ++p) {
+		size_t row = p / 2;
+		float sign = p % 2 ? -1.f : 1.f;
+		float length = 0;
+		for (size_t c = 0; c < 4; ++c) {
+			cull.planes[p][c] = clip.data[3 + 4 * c] + sign * clip.data[row + 4 * c];
+			if (c < 3) { length += cull.planes[p][c] * cull.planes[p][c]; }
+		}
+		length = sqrtf(length);
+		for (size_t c = 0; c < 4; ++c) { cull.planes[p][c] /= length; }
+	}
+	// the model matrix only moves and scales the mesh
+	cull.camera[0] = (shape->camera.x - shape->pos.x) * shape->scale;
+	cull.camera[1] = (shape->camera.y - shape->pos.y) * shape->scale;
+	cull.camera[2] = (shape->camera.z - shape->pos.z) * shape->scale;
+	return cull;
+}
+static int meshlet_visible(const MeshletCull* cull, const Meshlet* meshlet) {
+	for (size_t p = 0; p < 4; ++p) {
+		const float* plane = cull->planes[p];
+		float distance = plane[0] * meshlet->center[0] + plane[1] * meshlet->center[1] + plane[2] * meshlet->center[2] + plane[3];
+		if (distance < -meshlet->radius) { return 0; }
+	}
+	if (!cull->backface) { return 1; }
 
-	return ret;
+	// every triangle faces away if the camera sits inside the cone opened behind the sphere
+	float to_center[3] = {
+		meshlet->center[0] - cull->camera[0],
+		meshlet->center[1] - cull->camera[1],
+		meshlet->center[2] - cull->camera[2],
+	};
+	float distance = sqrtf(to_center[0] * to_center[0] + to_center[1] * to_center[1] + to_center[2] * to_center[2]);
+	float along = to_center[0] * meshlet->cone_axis[0] + to_center[1] * meshlet->cone_axis[1] + to_center[2] * meshlet->cone_axis[2];
+	return along < meshlet->cone_cutoff * distance + meshlet->radius;
 }
-void shape3d_show(Shape3D* shape, int x, int y, int w, int h, int screen_w, int screen_h) {
-	if (shape->face_cull) {
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-		glFrontFace(GL_CCW);
+// the meshlets of [begin, end) that are in view, neighbouring ones are merged into a single draw
+static void shape3d_draw_meshlets(Shape3D* shape, const MeshletCull* cull, size_t* next, uint32_t end) {
+	cyx_array_clear(shape->draw_counts);
+	cyx_array_clear(shape->draw_offsets);
+	size_t count = cyx_array_length(shape->meshlets);
+	for (; *next < count && shape->meshlets[*next].first_index < end; ++*next) {
+		const Meshlet* meshlet = &shape->meshlets[*next];
+		if (!meshlet_visible(cull, meshlet)) { continue; }
+		++shape->visible_meshlets;
+
+		size_t draws = cyx_array_length(shape->draw_counts);
+		if (draws && (uintptr_t)shape->draw_offsets[draws - 1] / sizeof(uint32_t) + shape->draw_counts[draws - 1] == meshlet->first_index) {
+			shape->draw_counts[draws - 1] += meshlet->index_count;
+		} else {
+			cyx_array_append(shape->draw_counts, (GLsizei)meshlet->index_count);
+			cyx_array_append(shape->draw_offsets, (void*)((uintptr_t)meshlet->first_index * sizeof(uint32_t)));
+		}
 	}
-	if (shape->depth_test) {
-		glEnable(GL_DEPTH_TEST);
-	} else {
-		glDisable(GL_DEPTH_TEST);
+	if (cyx_array_length(shape->draw_counts)) {
+		glMultiDrawElements(GL_TRIANGLES, shape->draw_counts, GL_UNSIGNED_INT, (const void* const*)shape->draw_offsets, cyx_array_length(shape->draw_counts));
 	}
-glViewport(x, y, w, h);
-	glUseProgram(shape->program);
+}
+void shape3d_show(Shape3D* shape, int x, int y, int w, int h) {
+	// back faces of counter clockwise triangles, the GL defaults
+	gl_set_cap(GL_STATE_CULL_FACE, shape->face_cull);
+	gl_set_cap(GL_STATE_DEPTH_TEST, shape->depth_test);
+	gl_viewport(x, y, w, h);
+	gl_use_program(shape->program->id);
 
-	int uniform_proj = glGetUniformLocation(shape->program, "u_proj"); 
-	int uniform_model = glGetUniformLocation(shape->program, "u_model");
-	int uniform_view = glGetUniformLocation(shape->program, "u_view");
+	Mat4 model = mat4_model(shape->pos, 0, vec4(0, 1, 0), vec4(1.f/shape->scale, 1.f/shape->scale, 1.f/shape->scale));
+	Mat4 proj = mat4_perspective(SHAPE3D_FOV, (float)w / h, SHAPE3D_NEAR, SHAPE3D_FAR);
+	Mat4 view = mat4_look_at(shape->camera, vec4(0, 0, 0), vec4(0, 1, 0));
 
-	int uniform_color = glGetUniformLocation(shape->program, "u_color");
-	int uniform_light_color = glGetUniformLocation(shape->program, "u_light_color");
+	// the shapes of one view share all of this, so only the first one of a frame uploads it
+	CameraBlockData camera = {
+		.light_color = { COLOR_UNPACK_F(shape->light_color) },
+		.light_pos = { shape->light_pos.x, shape->light_pos.y, shape->light_pos.z, 0 },
+		.view_pos = { shape->camera.x, shape->camera.y, shape->camera.z, 0 },
+	};
+	memcpy(camera.proj, proj.data, sizeof(camera.proj));
+	memcpy(camera.view, view.data, sizeof(camera.view));
+	camera_block_set(shape->camera_block, &camera);
+
+	const int32_t* uniforms = shape->program->uniforms;
+	glUniform4f(uniforms[UNIFORM_COLOR], COLOR_UNPACK_F(shape->color));
+	glUniform1f(uniforms[UNIFORM_SHININESS], shape->shininess);
+	glUniform1f(uniforms[UNIFORM_REFLECTIVITY], shape->reflectivity);
+
+	Mat4 normal = mat4_normal(model);
+	glUniformMatrix4fv(uniforms[UNIFORM_MODEL], 1, GL_FALSE, model.data);
+	glUniformMatrix4fv(uniforms[UNIFORM_NORMAL], 1, GL_FALSE, normal.data);
+
+	gl_bind_vertex_array(shape->vao[shape->front]);
+	uint32_t whole = shape->indicies_count[shape->front];
+	uint32_t range_count = shape->range_count > 1 ? shape->range_count : 1;
+	const uint32_t* range_ends = shape->range_count > 1 ? shape->range_ends : &whole;
+	int culled = shape->meshlets && cyx_array_length(shape->meshlets);
+	MeshletCull cull = { 0 };
+	if (culled) {
+		cull = meshlet_cull_setup(shape, model, view, proj);
+		shape->visible_meshlets = 0;
+	}
+
+	uint32_t begin = 0;
+	size_t next = 0;
+	for (uint32_t r = 0; r < range_count; ++r) {
+		if (range_count > 1) {
+			glUniform4f(uniforms[UNIFORM_COLOR], COLOR_UNPACK_F(shape3d_range_color(shape->color, r)));
+		}
+		if (culled) {
+			shape3d_draw_meshlets(shape, &cull, &next, range_ends[r]);
+		} else {
+			gl_draw_elements(GL_TRIANGLES, range_ends[r] - begin, GL_UNSIGNED_INT, (void*)((uintptr_t)begin * sizeof(uint32_t)));
+		}
+		begin = range_ends[r];
+	}
+}
+void shape3d_free(Shape3D* shape) {
+	gl_delete_vertex_arrays(2, shape->vao);
+	glDeleteBuffers(2, shape->vbo);
+	glDeleteBuffers(2, shape->ebo);
+	if (shape->meshlets) {
+		cyx_array_free(shape->meshlets);
+		cyx_array_free(shape->draw_counts);
+		cyx_array_free(shape->draw_offsets);
+	}
+}
 
-	int uniform_light_pos = glGetUniformLocation(shape->program, "u_light_pos");
-	int uniform_view_pos = glGetUniformLocation(shape->program, "u_view_pos");
-	int uniform_shininess = glGetUniformLocation(shape->program, "u_shininess");
-	int uniform_reflectivity = glGetUniformLocation(shape->program, "u_reflectivity");
+Image image_create(const Program* program) {
+	Image image = {
+		.program = program,
+	};
 
-	glUniform4f(uniform_color, COLOR_UNPACK_F(shape->color));
-	glUniform3f(uniform_light_pos, shape->light_pos.x, shape->light_pos.y, shape->light_pos.z);
-	glUniform4f(uniform_light_color, COLOR_UNPACK_F(shape->light_color));
+	// the first row of the pixels is the top of the image
+	float vertices[] = {
+		-1.0f,  1.0f, 0.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 1.0f,
+		 1.0f, -1.0f, 1.0f, 1.0f,
+		 1.0f,  1.0f, 1.0f, 0.0f,
+	};
 
-	glUniform3f(uniform_view_pos, shape->camera.x, shape->camera.y, shape->camera.z);
-	glUniform1f(uniform_shininess, shape->shininess);
-	glUniform1f(uniform_reflectivity, shape->reflectivity);
+	uint32_t triangles[] = {
+		0, 1, 2,
+		0, 2, 3
+	};
 
-	Mat4 model = mat4_model(shape->pos, 0, vec4(0, 1, 0), vec4(1.f/shape->scale, 1.f/shape->scale, 1.f/shape->scale));
-	Mat4 proj = mat4_perspective(60, (float)w / h, 1, 200);
-	Mat4 view = mat4_look_at(shape->camera, vec4(0, 0, 0), vec4(0, 1, 0));
+	glGenVertexArrays(1, &image.vao);
+	gl_bind_vertex_array(image.vao);
 
-	glUniformMatrix4fv(uniform_proj, 1, GL_FALSE, proj.data);
-	glUniformMatrix4fv(uniform_model, 1, GL_FALSE, model.data);
-	glUniformMatrix4fv(uniform_view, 1, GL_FALSE, view.data);
+	glGenBuffers(1, &image.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, image.vbo);
+	glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(float), vertices, GL_STATIC_DRAW);
 
-	glBindVertexArray(shape->vao);
-	glDrawElements(GL_TRIANGLES, shape->indicies_count, GL_UNSIGNED_INT, 0);
+	glGenBuffers(1, &image.ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, image.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint32_t), triangles, GL_STATIC_DRAW);
 
-	glBindVertexArray(0);
-	glUseProgram(0);
-	glViewport(0, 0, screen_w, screen_h);
-	if (shape->face_cull) {
-		glDisable(GL_CULL_FACE);
-	}
-	if (shape->depth_test) {
-		glDisable(GL_DEPTH_TEST);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	gl_bind_vertex_array(0);
+
+	glGenTextures(1, &image.texture);
+	gl_bind_texture(GL_TEXTURE_2D, image.texture);
+	// the pixels are usually at a lower resolution than the viewport
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+
+	return image;
+}
+void image_update(Image* image, int width, int height, const uint8_t* rgba) {
+	gl_bind_texture(GL_TEXTURE_2D, image->texture);
+	if (width == image->width && height == image->height) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	} else {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
 	}
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	image->width = width;
+	image->height = height;
 }
-void shape3d_free(Shape3D* shape) {
-	glDeleteVertexArrays(1, &shape->vao);
-	glDeleteBuffers(1, &shape->vbo);
-	glDeleteBuffers(1, &shape->ebo);
+void image_clear(Image* image) {
+	gl_bind_texture(GL_TEXTURE_2D, image->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+	image->width = 0;
+	image->height = 0;
+}
+void image_show(Image* image, int x, int y, int w, int h) {
+	image->shown_w = w;
+	image->shown_h = h;
+	if (!image->width || !image->height) { return; }
+
+	gl_set_cap(GL_STATE_DEPTH_TEST, 0);
+	gl_set_cap(GL_STATE_CULL_FACE, 0);
+	gl_viewport(x, y, w, h);
+	gl_use_program(image->program->id);
+
+	glActiveTexture(GL_TEXTURE0);
+	gl_bind_texture(GL_TEXTURE_2D, image->texture);
+	glUniform1i(image->program->uniforms[UNIFORM_TEXTURE], 0);
+
+	gl_bind_vertex_array(image->vao);
+	gl_draw_elements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+}
+void image_free(Image* image) {
+	gl_delete_vertex_arrays(1, &image->vao);
+	glDeleteBuffers(1, &image->vbo);
+	glDeleteBuffers(1, &image->ebo);
+	glDeleteTextures(1, &image->texture);
 }